@@ -5,6 +5,7 @@
 #include <vector>
 #include <atomic>
 #include "Math/vec.hpp"
+#include "Math/rect.hpp"
 
 /**
  * @brief Input subsystem
@@ -32,8 +33,19 @@ namespace input
 
     // Wait for external events
     // returns false if the system is shutting down
-    bool wait_for_mouse_button(int button, vec2i &mouse_pos);
+    // display (optional) receives the display the click happened on
+    bool wait_for_mouse_button(int button, vec2i &mouse_pos, ALLEGRO_DISPLAY **display = nullptr);
+
+    // Wait for the button to be pressed and released again outside the UI
+    // area spans press and release position (normalized), display (optional) is the one the press happened on
+    bool wait_for_mouse_drag(int button, recti &area, ALLEGRO_DISPLAY **display = nullptr);
 
     // get current mouse
     vec2i get_mouse_position();
+
+    // Whether the key is held right now, e.g. to tell a plain key from a chord another listener waits for
+    bool is_key_down(int keycode);
+
+    // Hardware events (keyboard and mouse) received since start, for rate displays
+    size_t getEventCount();
 }
\ No newline at end of file
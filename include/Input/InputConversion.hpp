@@ -1,5 +1,6 @@
 #include "webUiInput.hpp"
 #include <allegro5/allegro.h>
+#include "Math/vec.hpp"
 
 namespace input
 {
@@ -7,5 +8,8 @@ namespace input
     // allegro doesn't fully adhere to posix or any code standard for receiving events.
 
     wui::wui_err_t handleKeyEvent(const wui::wui_tab_id_t &tab_id, ALLEGRO_EVENT &event);
-    wui::wui_mouse_event_t convertMouseEvent(ALLEGRO_EVENT &event);
+
+    // Window to tab pixels: ui_origin is the top left of the UI viewport (Renderer::getUiViewport),
+    // ui_scale the UI resolution relative to the window (Renderer::getUiScale)
+    wui::wui_mouse_event_t convertMouseEvent(ALLEGRO_EVENT &event, vec2i ui_origin = {0, 0}, float ui_scale = 1.0f);
 }
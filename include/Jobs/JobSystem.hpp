@@ -0,0 +1,111 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Job system
+ * @details Global pool of worker threads with one work-stealing queue each
+ *
+ * parallel_for splits a range into chunks, hands contiguous runs of chunks to each worker
+ * and lets idle workers (and the calling thread) steal from the others until the range is done.
+ *
+ * Jobs never allocate: queues are fixed size rings, when they are full the chunk is run inline.
+ */
+namespace jobs
+{
+    // Start the workers, 0 picks hardware_concurrency - 1 (the calling thread always helps)
+    void start(size_t worker_count = 0);
+
+    // Stop and join all workers, pending jobs are finished first
+    void shutdown();
+
+    size_t getWorkerCount();
+
+    // Deterministic mode: parallel_reduce combines chunk results in chunk order
+    // so the result does not depend on scheduling or the worker count
+    void setDeterministic(bool deterministic);
+    bool isDeterministic();
+
+    // Chunk length so that one chunk of items with the given stride fits comfortably into L2
+    size_t cacheChunk(size_t bytes_per_item);
+
+    // Chunks parallel_for / parallel_reduce split [begin, end) into
+    inline size_t chunkCount(size_t begin, size_t end, size_t chunk)
+    {
+        chunk = chunk == 0 ? 1 : chunk;
+        return end <= begin ? 0 : (end - begin + chunk - 1) / chunk;
+    }
+
+    namespace detail
+    {
+        typedef void (*job_fn_t)(void *ctx, size_t begin, size_t end);
+
+        void run(size_t begin, size_t end, size_t chunk, job_fn_t fn, void *ctx);
+    }
+
+    // Call fn(chunk_begin, chunk_end) for every chunk of [begin, end) and wait for all of them
+    template <typename F>
+    void parallel_for(size_t begin, size_t end, size_t chunk, F &&fn)
+    {
+        using fn_t = std::remove_reference_t<F>;
+
+        detail::run(
+            begin, end, chunk, [](void *ctx, size_t b, size_t e)
+            { (*static_cast<fn_t *>(ctx))(b, e); },
+            (void *)&fn);
+    }
+
+    // map(chunk_begin, chunk_end) -> T for every chunk, then fold the results with reduce(T, T) -> T
+    // The chunk layout only depends on `chunk`, so in deterministic mode the result is reproducible
+    // Deterministic mode keeps one partial per chunk in `partials`, which has to be reserve()d for chunkCount beforehand:
+    // the call never grows it, so it stays allocation free (and may run inside WUI_ALLOC_FREE_SCOPE)
+    template <typename T, typename Map, typename Reduce>
+    T parallel_reduce(size_t begin, size_t end, size_t chunk, T identity, Map &&map, Reduce &&reduce, std::vector<T> &partials)
+    {
+        if (end <= begin)
+        {
+            return identity;
+        }
+
+        chunk = chunk == 0 ? 1 : chunk;
+
+        if (isDeterministic())
+        {
+            const size_t chunk_count = chunkCount(begin, end, chunk);
+            assert(chunk_count <= partials.capacity() && "jobs: reserve the partials for chunkCount first");
+            partials.assign(chunk_count, identity); // within capacity, never reallocates
+
+            parallel_for(begin, end, chunk, [&](size_t b, size_t e)
+                         { partials[(b - begin) / chunk] = map(b, e); });
+
+            T ret = identity;
+            for (auto &partial : partials)
+            {
+                ret = reduce(ret, partial);
+            }
+            return ret;
+        }
+
+        T ret = identity;
+        std::mutex l_ret;
+        parallel_for(begin, end, chunk, [&](size_t b, size_t e)
+                     {
+                         T partial = map(b, e);
+                         l_ret.lock();
+                         ret = reduce(ret, partial);
+                         l_ret.unlock(); });
+        return ret;
+    }
+
+    template <typename T, typename Map, typename Reduce>
+    T parallel_reduce(size_t begin, size_t end, size_t chunk, T identity, Map &&map, Reduce &&reduce)
+    {
+        std::vector<T> partials;
+        partials.reserve(chunkCount(begin, end, chunk));
+        return parallel_reduce(begin, end, chunk, identity, std::forward<Map>(map), std::forward<Reduce>(reduce), partials);
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+/**
+ * @brief Logging setup
+ * @details Everything logs through spdlog, this only swaps what sits behind the default logger.
+ *
+ * Async mode: the default logger gets a single sink that copies each (already level filtered) message
+ * into a bounded lock-free ring, a backend thread pops them and does the pattern formatting and I/O.
+ * When the ring is full the message is dropped and counted instead of blocking the caller.
+ *
+ * Hot paths use SPDLOG_DEBUG / SPDLOG_TRACE, which SPDLOG_ACTIVE_LEVEL (set by CMake) removes at compile time,
+ * or WUI_LOG_RATE_LIMITED for messages that may fire every frame.
+ */
+namespace logging
+{
+    // Route the default logger through the async ring, queue_size is rounded up to a power of two
+    void startAsync(size_t queue_size = 4096);
+
+    // Drain the ring, join the backend thread and restore a synchronous default logger
+    void shutdown();
+
+    // Messages lost because the ring was full
+    size_t getDroppedCount();
+
+    // Lets one message per interval through and counts the rest, one instance per call site
+    class RateLimiter
+    {
+    public:
+        explicit RateLimiter(std::chrono::milliseconds interval) : m_interval_ns(std::chrono::nanoseconds(interval).count()) {}
+
+        // true if the caller may log now, suppressed receives how many were swallowed since the last one
+        bool allow(size_t &suppressed)
+        {
+            const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            int64_t last = m_last_ns.load(std::memory_order_relaxed);
+
+            if (last != 0 && now - last < m_interval_ns)
+            {
+                m_suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            if (!m_last_ns.compare_exchange_strong(last, now, std::memory_order_relaxed))
+            {
+                m_suppressed.fetch_add(1, std::memory_order_relaxed); // another thread won this slot
+                return false;
+            }
+
+            suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        const int64_t m_interval_ns;
+        std::atomic<int64_t> m_last_ns = ATOMIC_VAR_INIT(0);
+        std::atomic<size_t> m_suppressed = ATOMIC_VAR_INIT(0);
+    };
+}
+
+// Log at most once per interval_ms from this call site, the next message that gets through reports how many were suppressed
+#define WUI_LOG_RATE_LIMITED(level, interval_ms, fmt_str, ...)                                                    \
+    do                                                                                                            \
+    {                                                                                                             \
+        static logging::RateLimiter wui_rate_limiter_(std::chrono::milliseconds(interval_ms));                   \
+        size_t wui_suppressed_ = 0;                                                                               \
+        if (spdlog::should_log(level) && wui_rate_limiter_.allow(wui_suppressed_))                                \
+        {                                                                                                         \
+            if (wui_suppressed_ > 0)                                                                              \
+                spdlog::log(level, fmt_str " ({} similar suppressed)", ##__VA_ARGS__, wui_suppressed_);           \
+            else                                                                                                  \
+                spdlog::log(level, fmt_str, ##__VA_ARGS__);                                                       \
+        }                                                                                                         \
+    } while (0)
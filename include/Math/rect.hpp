@@ -0,0 +1,51 @@
+#pragma once
+#include "Math/vec.hpp"
+
+namespace WUI
+{
+    // Axis aligned rectangle, min inclusive / max exclusive
+    template <typename T>
+    class rect
+    {
+    public:
+        vec2<T> min;
+        vec2<T> max;
+
+        constexpr rect() noexcept = default;
+        constexpr rect(vec2<T> min, vec2<T> max) noexcept : min(min), max(max) {}
+        constexpr rect(T x, T y, T w, T h) noexcept : min(x, y), max(x + w, y + h) {}
+
+        // square around a circle
+        static constexpr rect around(vec2<T> center, T radius) noexcept
+        {
+            return {{center.x - radius, center.y - radius}, {center.x + radius, center.y + radius}};
+        }
+
+        constexpr T width() const noexcept { return max.x - min.x; }
+        constexpr T height() const noexcept { return max.y - min.y; }
+        constexpr bool empty() const noexcept { return max.x <= min.x || max.y <= min.y; }
+
+        constexpr bool contains(vec2<T> p) const noexcept
+        {
+            return p.x >= min.x && p.y >= min.y && p.x < max.x && p.y < max.y;
+        }
+
+        constexpr bool contains(const rect &other) const noexcept
+        {
+            return other.min.x >= min.x && other.min.y >= min.y && other.max.x <= max.x && other.max.y <= max.y;
+        }
+
+        constexpr bool intersects(const rect &other) const noexcept
+        {
+            return min.x < other.max.x && other.min.x < max.x && min.y < other.max.y && other.min.y < max.y;
+        }
+
+        template <typename T2>
+        constexpr operator rect<T2>() const noexcept
+        {
+            return rect<T2>((vec2<T2>)min, (vec2<T2>)max);
+        }
+    };
+}
+using rectf = WUI::rect<float>;
+using recti = WUI::rect<int>;
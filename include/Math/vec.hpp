@@ -1,9 +1,23 @@
-
 #pragma once
 #include <cmath>
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
 namespace WUI
 {
+    // 1 / sqrt(v), hardware estimate refined by one Newton-Raphson step (~23 bit precise) where available
+    inline float rsqrt(float v) noexcept
+    {
+#if defined(__SSE__)
+        const float estimate = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(v)));
+        return estimate * (1.5f - 0.5f * v * estimate * estimate);
+#else
+        return 1.0f / std::sqrt(v);
+#endif
+    }
+
     template <typename T>
     class vec2
     {
@@ -11,78 +25,201 @@ namespace WUI
         T x;
         T y;
 
-        vec2(T x = 0, T y = 0) : x(x), y(y)
+        constexpr vec2(T x = 0, T y = 0) noexcept : x(x), y(y)
         {
         }
 
         template <typename T2>
-        vec2 operator*(T2 scale)
+        constexpr vec2 operator*(T2 scale) const noexcept
         {
             return {(T)(x * scale), (T)(y * scale)};
         }
 
         template <typename T2>
-        vec2 operator/(T2 divisor)
+        constexpr vec2 operator/(T2 divisor) const noexcept
         {
             return {(T)((double)x / (double)divisor), (T)((double)y / (double)divisor)};
         }
 
-        /*vec2 operator*(float scale)
-        {
-          return {x * scale, y * scale};
-        }*/
-
-        vec2 operator+(const vec2 other) const
+        constexpr vec2 operator+(const vec2 other) const noexcept
         {
             return {x + other.x, y + other.y};
         }
 
-        vec2 operator+=(const vec2 other)
+        constexpr vec2 &operator+=(const vec2 other) noexcept
         {
-
             x += other.x;
             y += other.y;
-
-            return {x, y};
+            return *this;
         }
 
-        vec2 operator-(const vec2 other) const
+        constexpr vec2 operator-(const vec2 other) const noexcept
         {
             return {x - other.x, y - other.y};
         }
 
-        bool operator==(const vec2 other) const
+        constexpr vec2 &operator-=(const vec2 other) noexcept
+        {
+            x -= other.x;
+            y -= other.y;
+            return *this;
+        }
+
+        template <typename T2>
+        constexpr vec2 &operator*=(T2 scale) noexcept
+        {
+            x = (T)(x * scale);
+            y = (T)(y * scale);
+            return *this;
+        }
+
+        constexpr vec2 operator-() const noexcept
+        {
+            return {-x, -y};
+        }
+
+        constexpr bool operator==(const vec2 other) const noexcept
         {
             return x == other.x && y == other.y;
         }
 
-        bool operator!=(const vec2 other) const
+        constexpr bool operator!=(const vec2 other) const noexcept
         {
             return !(this->operator==(other));
         }
 
         template <typename T2>
-        operator vec2<T2>() const
+        constexpr operator vec2<T2>() const noexcept
         {
             return vec2<T2>((T2)x, (T2)y);
         }
 
-        float mag() const
+        // squared magnitude, prefer this for comparisons
+        constexpr T mag2() const noexcept
+        {
+            return x * x + y * y;
+        }
+
+        float mag() const noexcept
         {
-            return std::sqrt(x * x + y * y);
+            return std::sqrt((float)mag2());
         }
 
-        float dot(vec2 other) const
+        constexpr T dot(vec2 other) const noexcept
         {
             return x * other.x + y * other.y;
         }
 
-        vec2<float> dir() const // i.e. normalize
+        vec2<float> dir() const noexcept // i.e. normalize
+        {
+            const float m = mag();
+            if (m == 0)
+            {
+                return {0, 0};
+            }
+            const float inv = 1.0f / m;
+            return {(float)x * inv, (float)y * inv};
+        }
+
+        // normalize through the reciprocal square root estimate, for hot loops that tolerate ~1e-6 error
+        vec2<float> dir_fast() const noexcept
+        {
+            const float m2 = (float)mag2();
+            if (m2 == 0)
+            {
+                return {0, 0};
+            }
+            const float inv = rsqrt(m2);
+            return {(float)x * inv, (float)y * inv};
+        }
+    };
+
+    template <typename T>
+    class vec4
+    {
+    public:
+        T x;
+        T y;
+        T z;
+        T w;
+
+        constexpr vec4(T x = 0, T y = 0, T z = 0, T w = 0) noexcept : x(x), y(y), z(z), w(w)
+        {
+        }
+
+        constexpr vec4(vec2<T> xy, vec2<T> zw) noexcept : x(xy.x), y(xy.y), z(zw.x), w(zw.y)
+        {
+        }
+
+        template <typename T2>
+        constexpr vec4 operator*(T2 scale) const noexcept
+        {
+            return {(T)(x * scale), (T)(y * scale), (T)(z * scale), (T)(w * scale)};
+        }
+
+        constexpr vec4 operator+(const vec4 other) const noexcept
+        {
+            return {x + other.x, y + other.y, z + other.z, w + other.w};
+        }
+
+        constexpr vec4 &operator+=(const vec4 other) noexcept
+        {
+            x += other.x;
+            y += other.y;
+            z += other.z;
+            w += other.w;
+            return *this;
+        }
+
+        constexpr vec4 operator-(const vec4 other) const noexcept
+        {
+            return {x - other.x, y - other.y, z - other.z, w - other.w};
+        }
+
+        constexpr bool operator==(const vec4 other) const noexcept
+        {
+            return x == other.x && y == other.y && z == other.z && w == other.w;
+        }
+
+        constexpr bool operator!=(const vec4 other) const noexcept
+        {
+            return !(this->operator==(other));
+        }
+
+        template <typename T2>
+        constexpr operator vec4<T2>() const noexcept
+        {
+            return vec4<T2>((T2)x, (T2)y, (T2)z, (T2)w);
+        }
+
+        constexpr vec2<T> xy() const noexcept
+        {
+            return {x, y};
+        }
+
+        constexpr vec2<T> zw() const noexcept
+        {
+            return {z, w};
+        }
+
+        constexpr T dot(vec4 other) const noexcept
+        {
+            return x * other.x + y * other.y + z * other.z + w * other.w;
+        }
+
+        constexpr T mag2() const noexcept
+        {
+            return dot(*this);
+        }
+
+        float mag() const noexcept
         {
-            return {((float)x) / mag(), ((float)y) / mag()};
+            return std::sqrt((float)mag2());
         }
     };
 
 };
 using vec2f = WUI::vec2<float>;
-using vec2i = WUI::vec2<int>;
\ No newline at end of file
+using vec2i = WUI::vec2<int>;
+using vec4f = WUI::vec4<float>;
+using vec4i = WUI::vec4<int>;
@@ -0,0 +1,405 @@
+#pragma once
+#include "Math/vec.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+/**
+ * Packed vector types and batch helpers
+ *
+ * vec2x4 / vec2x8 hold 4 / 8 vec2f in SoA layout (all x, then all y) so one instruction works on every lane.
+ * vec2x4 uses SSE, vec2x8 uses AVX, both fall back to plain arrays (or two vec2x4) when the target lacks them.
+ * load/store convert from and to the usual interleaved (AoS) vec2f arrays.
+ */
+namespace WUI
+{
+    // Non owning view over contiguous elements (std::span is C++20)
+    template <typename T>
+    class span
+    {
+    public:
+        constexpr span() noexcept = default;
+        constexpr span(T *data, size_t size) noexcept : m_data(data), m_size(size) {}
+
+        template <typename U>
+        span(std::vector<U> &v) noexcept : m_data(v.data()), m_size(v.size()) {}
+
+        template <typename U>
+        span(const std::vector<U> &v) noexcept : m_data(v.data()), m_size(v.size()) {}
+
+        constexpr T *data() const noexcept { return m_data; }
+        constexpr size_t size() const noexcept { return m_size; }
+        constexpr bool empty() const noexcept { return m_size == 0; }
+        constexpr T &operator[](size_t i) const noexcept { return m_data[i]; }
+        constexpr T *begin() const noexcept { return m_data; }
+        constexpr T *end() const noexcept { return m_data + m_size; }
+
+        constexpr span subspan(size_t offset, size_t count) const noexcept
+        {
+            return {m_data + offset, count};
+        }
+
+    private:
+        T *m_data = nullptr;
+        size_t m_size = 0;
+    };
+
+    class alignas(16) vec2x4
+    {
+    public:
+        static const size_t WIDTH = 4;
+
+#if defined(__SSE__)
+        __m128 x;
+        __m128 y;
+
+        vec2x4() noexcept : x(_mm_setzero_ps()), y(_mm_setzero_ps()) {}
+        vec2x4(__m128 x, __m128 y) noexcept : x(x), y(y) {}
+
+        static vec2x4 splat(vec2f v) noexcept
+        {
+            return {_mm_set1_ps(v.x), _mm_set1_ps(v.y)};
+        }
+
+        // 4 interleaved vec2f -> SoA
+        static vec2x4 load(const vec2f *aos) noexcept
+        {
+            const __m128 a = _mm_loadu_ps(&aos[0].x); // x0 y0 x1 y1
+            const __m128 b = _mm_loadu_ps(&aos[2].x); // x2 y2 x3 y3
+            return {_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))};
+        }
+
+        void store(vec2f *aos) const noexcept
+        {
+            _mm_storeu_ps(&aos[0].x, _mm_unpacklo_ps(x, y));
+            _mm_storeu_ps(&aos[2].x, _mm_unpackhi_ps(x, y));
+        }
+
+        vec2x4 operator+(const vec2x4 &o) const noexcept { return {_mm_add_ps(x, o.x), _mm_add_ps(y, o.y)}; }
+        vec2x4 operator-(const vec2x4 &o) const noexcept { return {_mm_sub_ps(x, o.x), _mm_sub_ps(y, o.y)}; }
+
+        vec2x4 operator*(float s) const noexcept
+        {
+            const __m128 vs = _mm_set1_ps(s);
+            return {_mm_mul_ps(x, vs), _mm_mul_ps(y, vs)};
+        }
+
+        // this + v * s
+        vec2x4 mul_add(const vec2x4 &v, float s) const noexcept
+        {
+            const __m128 vs = _mm_set1_ps(s);
+            return {_mm_add_ps(x, _mm_mul_ps(v.x, vs)), _mm_add_ps(y, _mm_mul_ps(v.y, vs))};
+        }
+
+        void mag2(float *out) const noexcept
+        {
+            _mm_storeu_ps(out, _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+        }
+
+        // rsqrt estimate + one Newton-Raphson step, zero vectors stay zero
+        vec2x4 dir_fast() const noexcept
+        {
+            const __m128 m2 = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y));
+            const __m128 e = _mm_rsqrt_ps(m2);
+            __m128 inv = _mm_mul_ps(e, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), m2), _mm_mul_ps(e, e))));
+            inv = _mm_and_ps(inv, _mm_cmpgt_ps(m2, _mm_setzero_ps()));
+            return {_mm_mul_ps(x, inv), _mm_mul_ps(y, inv)};
+        }
+#else
+        float x[4];
+        float y[4];
+
+        vec2x4() noexcept : x{0, 0, 0, 0}, y{0, 0, 0, 0} {}
+
+        static vec2x4 splat(vec2f v) noexcept
+        {
+            vec2x4 r;
+            for (size_t i = 0; i < 4; i++)
+            {
+                r.x[i] = v.x;
+                r.y[i] = v.y;
+            }
+            return r;
+        }
+
+        static vec2x4 load(const vec2f *aos) noexcept
+        {
+            vec2x4 r;
+            for (size_t i = 0; i < 4; i++)
+            {
+                r.x[i] = aos[i].x;
+                r.y[i] = aos[i].y;
+            }
+            return r;
+        }
+
+        void store(vec2f *aos) const noexcept
+        {
+            for (size_t i = 0; i < 4; i++)
+            {
+                aos[i] = {x[i], y[i]};
+            }
+        }
+
+        vec2x4 operator+(const vec2x4 &o) const noexcept
+        {
+            vec2x4 r;
+            for (size_t i = 0; i < 4; i++)
+            {
+                r.x[i] = x[i] + o.x[i];
+                r.y[i] = y[i] + o.y[i];
+            }
+            return r;
+        }
+
+        vec2x4 operator-(const vec2x4 &o) const noexcept
+        {
+            vec2x4 r;
+            for (size_t i = 0; i < 4; i++)
+            {
+                r.x[i] = x[i] - o.x[i];
+                r.y[i] = y[i] - o.y[i];
+            }
+            return r;
+        }
+
+        vec2x4 operator*(float s) const noexcept
+        {
+            vec2x4 r;
+            for (size_t i = 0; i < 4; i++)
+            {
+                r.x[i] = x[i] * s;
+                r.y[i] = y[i] * s;
+            }
+            return r;
+        }
+
+        vec2x4 mul_add(const vec2x4 &v, float s) const noexcept
+        {
+            vec2x4 r;
+            for (size_t i = 0; i < 4; i++)
+            {
+                r.x[i] = x[i] + v.x[i] * s;
+                r.y[i] = y[i] + v.y[i] * s;
+            }
+            return r;
+        }
+
+        void mag2(float *out) const noexcept
+        {
+            for (size_t i = 0; i < 4; i++)
+            {
+                out[i] = x[i] * x[i] + y[i] * y[i];
+            }
+        }
+
+        vec2x4 dir_fast() const noexcept
+        {
+            vec2x4 r;
+            for (size_t i = 0; i < 4; i++)
+            {
+                const vec2f d = vec2f(x[i], y[i]).dir_fast();
+                r.x[i] = d.x;
+                r.y[i] = d.y;
+            }
+            return r;
+        }
+#endif
+    };
+
+    class alignas(32) vec2x8
+    {
+    public:
+        static const size_t WIDTH = 8;
+
+#if defined(__AVX__)
+        __m256 x;
+        __m256 y;
+
+        vec2x8() noexcept : x(_mm256_setzero_ps()), y(_mm256_setzero_ps()) {}
+        vec2x8(__m256 x, __m256 y) noexcept : x(x), y(y) {}
+
+        static vec2x8 splat(vec2f v) noexcept
+        {
+            return {_mm256_set1_ps(v.x), _mm256_set1_ps(v.y)};
+        }
+
+        // 8 interleaved vec2f -> SoA, shuffles only work within 128 bit lanes so regroup the halves first
+        static vec2x8 load(const vec2f *aos) noexcept
+        {
+            const __m256 a = _mm256_loadu_ps(&aos[0].x); // x0 y0 x1 y1 | x2 y2 x3 y3
+            const __m256 b = _mm256_loadu_ps(&aos[4].x); // x4 y4 x5 y5 | x6 y6 x7 y7
+            const __m256 lo = _mm256_permute2f128_ps(a, b, 0x20); // x0 y0 x1 y1 | x4 y4 x5 y5
+            const __m256 hi = _mm256_permute2f128_ps(a, b, 0x31); // x2 y2 x3 y3 | x6 y6 x7 y7
+            return {_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)), _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))};
+        }
+
+        void store(vec2f *aos) const noexcept
+        {
+            const __m256 lo = _mm256_unpacklo_ps(x, y); // x0 y0 x1 y1 | x4 y4 x5 y5
+            const __m256 hi = _mm256_unpackhi_ps(x, y); // x2 y2 x3 y3 | x6 y6 x7 y7
+            _mm256_storeu_ps(&aos[0].x, _mm256_permute2f128_ps(lo, hi, 0x20));
+            _mm256_storeu_ps(&aos[4].x, _mm256_permute2f128_ps(lo, hi, 0x31));
+        }
+
+        vec2x8 operator+(const vec2x8 &o) const noexcept { return {_mm256_add_ps(x, o.x), _mm256_add_ps(y, o.y)}; }
+        vec2x8 operator-(const vec2x8 &o) const noexcept { return {_mm256_sub_ps(x, o.x), _mm256_sub_ps(y, o.y)}; }
+
+        vec2x8 operator*(float s) const noexcept
+        {
+            const __m256 vs = _mm256_set1_ps(s);
+            return {_mm256_mul_ps(x, vs), _mm256_mul_ps(y, vs)};
+        }
+
+        vec2x8 mul_add(const vec2x8 &v, float s) const noexcept
+        {
+            const __m256 vs = _mm256_set1_ps(s);
+            return {_mm256_add_ps(x, _mm256_mul_ps(v.x, vs)), _mm256_add_ps(y, _mm256_mul_ps(v.y, vs))};
+        }
+
+        void mag2(float *out) const noexcept
+        {
+            _mm256_storeu_ps(out, _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)));
+        }
+
+        vec2x8 dir_fast() const noexcept
+        {
+            const __m256 m2 = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+            const __m256 e = _mm256_rsqrt_ps(m2);
+            __m256 inv = _mm256_mul_ps(e, _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), m2), _mm256_mul_ps(e, e))));
+            inv = _mm256_and_ps(inv, _mm256_cmp_ps(m2, _mm256_setzero_ps(), _CMP_GT_OQ));
+            return {_mm256_mul_ps(x, inv), _mm256_mul_ps(y, inv)};
+        }
+#else
+        // two SSE (or scalar) halves
+        vec2x4 lo;
+        vec2x4 hi;
+
+        vec2x8() noexcept = default;
+        vec2x8(const vec2x4 &lo, const vec2x4 &hi) noexcept : lo(lo), hi(hi) {}
+
+        static vec2x8 splat(vec2f v) noexcept
+        {
+            return {vec2x4::splat(v), vec2x4::splat(v)};
+        }
+
+        static vec2x8 load(const vec2f *aos) noexcept
+        {
+            return {vec2x4::load(aos), vec2x4::load(aos + 4)};
+        }
+
+        void store(vec2f *aos) const noexcept
+        {
+            lo.store(aos);
+            hi.store(aos + 4);
+        }
+
+        vec2x8 operator+(const vec2x8 &o) const noexcept { return {lo + o.lo, hi + o.hi}; }
+        vec2x8 operator-(const vec2x8 &o) const noexcept { return {lo - o.lo, hi - o.hi}; }
+        vec2x8 operator*(float s) const noexcept { return {lo * s, hi * s}; }
+        vec2x8 mul_add(const vec2x8 &v, float s) const noexcept { return {lo.mul_add(v.lo, s), hi.mul_add(v.hi, s)}; }
+
+        void mag2(float *out) const noexcept
+        {
+            lo.mag2(out);
+            hi.mag2(out + 4);
+        }
+
+        vec2x8 dir_fast() const noexcept { return {lo.dir_fast(), hi.dir_fast()}; }
+#endif
+    };
+
+    // Batch helpers, widest packed type for the bulk and scalar code for the tail
+    namespace batch
+    {
+        // positions[i] += velocities[i] * dt
+        inline void integrate(span<vec2f> positions, span<const vec2f> velocities, float dt) noexcept
+        {
+            const size_t n = positions.size() < velocities.size() ? positions.size() : velocities.size();
+            size_t i = 0;
+            for (; i + vec2x8::WIDTH <= n; i += vec2x8::WIDTH)
+            {
+                vec2x8::load(&positions[i]).mul_add(vec2x8::load(&velocities[i]), dt).store(&positions[i]);
+            }
+            for (; i < n; i++)
+            {
+                positions[i] += velocities[i] * dt;
+            }
+        }
+
+        // v[i] = v[i].dir_fast()
+        inline void normalize(span<vec2f> v) noexcept
+        {
+            size_t i = 0;
+            for (; i + vec2x8::WIDTH <= v.size(); i += vec2x8::WIDTH)
+            {
+                vec2x8::load(&v[i]).dir_fast().store(&v[i]);
+            }
+            for (; i < v.size(); i++)
+            {
+                v[i] = v[i].dir_fast();
+            }
+        }
+
+        // out[i] = |points[i] - p|^2, out must hold points.size() floats
+        inline void dist2(span<const vec2f> points, vec2f p, span<float> out) noexcept
+        {
+            const vec2x8 pp = vec2x8::splat(p);
+            size_t i = 0;
+            for (; i + vec2x8::WIDTH <= points.size(); i += vec2x8::WIDTH)
+            {
+                (vec2x8::load(&points[i]) - pp).mag2(&out[i]);
+            }
+            for (; i < points.size(); i++)
+            {
+                out[i] = (points[i] - p).mag2();
+            }
+        }
+
+        // Index of the point closest to p, SIZE_MAX if there are none
+        inline size_t nearest(span<const vec2f> points, vec2f p, float *out_dist2 = nullptr) noexcept
+        {
+            size_t best = SIZE_MAX;
+            float best_d2 = 0;
+
+            alignas(32) float d2[vec2x8::WIDTH];
+            const vec2x8 pp = vec2x8::splat(p);
+
+            size_t i = 0;
+            for (; i + vec2x8::WIDTH <= points.size(); i += vec2x8::WIDTH)
+            {
+                (vec2x8::load(&points[i]) - pp).mag2(d2);
+                for (size_t l = 0; l < vec2x8::WIDTH; l++)
+                {
+                    if (best == SIZE_MAX || d2[l] < best_d2)
+                    {
+                        best = i + l;
+                        best_d2 = d2[l];
+                    }
+                }
+            }
+            for (; i < points.size(); i++)
+            {
+                const float d = (points[i] - p).mag2();
+                if (best == SIZE_MAX || d < best_d2)
+                {
+                    best = i;
+                    best_d2 = d;
+                }
+            }
+
+            if (out_dist2 != nullptr)
+            {
+                *out_dist2 = best_d2;
+            }
+            return best;
+        }
+    }
+}
@@ -1,8 +1,16 @@
 
 #pragma once
 #include "Renderable.hpp"
+#include "Objects/Snapshot.hpp"
 #include <allegro5/allegro.h>
 
+struct cJSON;
+
+namespace render
+{
+    class SoftRasterizer;
+}
+
 namespace objects
 {
 
@@ -11,15 +19,29 @@ namespace objects
 
     private:
         float m_radius;
-        float m_speed;
-        float m_angle;
+        vec2f m_velocity; // px / s
         ALLEGRO_COLOR m_color;
 
     public:
         Ball(int x, int y);
-        void render(const size_t displayWidth, const size_t displayHeight, const double delta_t) override;
+        explicit Ball(const BallRecord &record);
+        void update(const size_t displayWidth, const size_t displayHeight, const double delta_t);
+        void draw();
+        void rasterize(render::SoftRasterizer &raster) const;
+
+        rectf getBounds() const;
+        bool hitTest(vec2f point) const;
 
+        // position and color for the UI
+        void serialize(cJSON *out) const;
+
+        float getRadius() const;
+
+        // radius^2 as mass
+        double getKineticEnergy() const;
         ALLEGRO_COLOR getColor() const;
+
+        BallRecord toRecord() const;
     };
 
 }
\ No newline at end of file
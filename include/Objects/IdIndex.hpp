@@ -0,0 +1,168 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Objects/ObjectPool.hpp"
+
+namespace objects
+{
+    /**
+     * Object id (as known to the UI) -> Handle
+     *
+     * Open addressing with linear probing in one flat array, erase shifts the following entries back instead of leaving
+     * tombstones. Unlike a node based map, inserting and erasing never touch the allocator while the table is below
+     * its load limit, so once reserve()d for the object count spawning and deleting stays allocation free.
+     *
+     * Not thread safe, the owner has to lock.
+     */
+    class IdIndex
+    {
+    public:
+        // Make sure at least `count` ids fit without allocating
+        void reserve(size_t count)
+        {
+            size_t capacity = m_slots.empty() ? MIN_CAPACITY : m_slots.size();
+            while (capacity * MAX_LOAD_NUM < count * MAX_LOAD_DEN)
+            {
+                capacity *= 2;
+            }
+
+            if (capacity != m_slots.size())
+            {
+                rehash(capacity);
+            }
+        }
+
+        // Insert or overwrite
+        void insert(int id, Handle handle)
+        {
+            reserve(m_size + 1);
+
+            size_t i = slotOf(id);
+            while (m_slots[i].used)
+            {
+                if (m_slots[i].id == id)
+                {
+                    m_slots[i].handle = handle;
+                    return;
+                }
+                i = (i + 1) & m_mask;
+            }
+
+            m_slots[i] = {id, true, handle};
+            m_size++;
+        }
+
+        // nullptr if the id is unknown
+        const Handle *find(int id) const
+        {
+            if (m_size == 0)
+            {
+                return nullptr;
+            }
+
+            for (size_t i = slotOf(id); m_slots[i].used; i = (i + 1) & m_mask)
+            {
+                if (m_slots[i].id == id)
+                {
+                    return &m_slots[i].handle;
+                }
+            }
+            return nullptr;
+        }
+
+        bool erase(int id)
+        {
+            if (m_size == 0)
+            {
+                return false;
+            }
+
+            size_t hole = slotOf(id);
+            while (!m_slots[hole].used || m_slots[hole].id != id)
+            {
+                if (!m_slots[hole].used)
+                {
+                    return false;
+                }
+                hole = (hole + 1) & m_mask;
+            }
+
+            // backward shift: move every later entry of the probe run whose home is not between the hole and itself
+            for (size_t i = (hole + 1) & m_mask; m_slots[i].used; i = (i + 1) & m_mask)
+            {
+                const size_t home = slotOf(m_slots[i].id);
+                if (((i - home) & m_mask) >= ((i - hole) & m_mask))
+                {
+                    m_slots[hole] = m_slots[i];
+                    hole = i;
+                }
+            }
+
+            m_slots[hole].used = false;
+            m_size--;
+            return true;
+        }
+
+        // Forget every id, the table keeps its capacity
+        void clear()
+        {
+            for (auto &slot : m_slots)
+            {
+                slot.used = false;
+            }
+            m_size = 0;
+        }
+
+        size_t size() const { return m_size; }
+
+    private:
+        static const size_t MIN_CAPACITY = 64;
+
+        // at most half full, probe runs stay short
+        static const size_t MAX_LOAD_NUM = 1;
+        static const size_t MAX_LOAD_DEN = 2;
+
+        struct Slot
+        {
+            int id = 0;
+            bool used = false;
+            Handle handle;
+        };
+
+        std::vector<Slot> m_slots;
+        size_t m_mask = 0;
+        unsigned int m_shift = 64; // 64 - log2(capacity)
+        size_t m_size = 0;
+
+        // ids are sequential, a multiplicative (Fibonacci) hash spreads neighbours over the table
+        size_t slotOf(int id) const
+        {
+            return (size_t)(((uint64_t)(uint32_t)id * 11400714819323198485ull) >> m_shift);
+        }
+
+        void rehash(size_t capacity)
+        {
+            std::vector<Slot> old;
+            old.swap(m_slots);
+
+            m_slots.resize(capacity);
+            m_mask = capacity - 1;
+            m_shift = 64;
+            for (size_t c = capacity; c > 1; c >>= 1)
+            {
+                m_shift--;
+            }
+            m_size = 0;
+
+            for (const auto &slot : old)
+            {
+                if (slot.used)
+                {
+                    insert(slot.id, slot.handle);
+                }
+            }
+        }
+    };
+}
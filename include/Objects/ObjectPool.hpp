@@ -0,0 +1,210 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace objects
+{
+    // Slot index + generation, a destroyed object's handle never resolves again even if the slot is reused
+    // type is the pool's index in the object type registry (ObjectTypes.hpp)
+    struct Handle
+    {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+        uint32_t type = 0;
+
+        bool valid() const { return index != UINT32_MAX; }
+        bool operator==(const Handle &other) const { return index == other.index && generation == other.generation && type == other.type; }
+        bool operator!=(const Handle &other) const { return !(*this == other); }
+    };
+
+    struct PoolStats
+    {
+        size_t live = 0;
+        size_t peak_live = 0;
+        size_t capacity = 0;
+        size_t created = 0;
+        size_t destroyed = 0;
+        size_t chunk_allocations = 0; // the only time the pool touches the global allocator
+    };
+
+    /**
+     * Fixed block pool for game objects
+     *
+     * Objects live in chunks of CHUNK_SIZE slots that are never freed until the pool is destroyed,
+     * so once the pool has grown (or was reserve()d) creating and destroying objects does not allocate.
+     * Live objects are additionally kept in a dense array (swap remove) for cache friendly iteration.
+     *
+     * T must expose a `Handle m_handle` member the pool may write (intrusive handle, see Renderable),
+     * so destroying through a plain pointer is O(1).
+     *
+     * Not thread safe, the owner has to lock.
+     */
+    template <typename T, size_t CHUNK_SIZE = 1024>
+    class ObjectPool
+    {
+    public:
+        ObjectPool() = default;
+        ~ObjectPool() { clear(); }
+
+        ObjectPool(const ObjectPool &) = delete;
+        ObjectPool &operator=(const ObjectPool &) = delete;
+
+        // Make sure at least `count` objects fit without allocating
+        void reserve(size_t count)
+        {
+            while (capacity() < count)
+            {
+                grow();
+            }
+        }
+
+        template <typename... Args>
+        T *create(Args &&...args)
+        {
+            if (m_free.empty())
+            {
+                grow();
+            }
+
+            const uint32_t index = m_free.back();
+            m_free.pop_back();
+
+            T *obj = new (slotStorage(index)) T(std::forward<Args>(args)...);
+
+            obj->m_handle = {index, m_generations[index], m_type};
+            m_slot_dense[index] = (uint32_t)m_dense.size();
+            m_dense.push_back(obj);
+
+            m_stats.created++;
+            m_stats.live = m_dense.size();
+            m_stats.peak_live = std::max(m_stats.peak_live, m_stats.live);
+            return obj;
+        }
+
+        // nullptr if the handle is stale or was never valid
+        T *get(Handle handle) const
+        {
+            if (handle.type != m_type || handle.index >= m_generations.size() || m_generations[handle.index] != handle.generation || m_slot_dense[handle.index] == UINT32_MAX)
+            {
+                return nullptr;
+            }
+            return m_dense[m_slot_dense[handle.index]];
+        }
+
+        bool destroy(Handle handle)
+        {
+            T *obj = get(handle);
+            if (obj == nullptr)
+            {
+                return false;
+            }
+
+            // swap remove from the dense array
+            const uint32_t dense_index = m_slot_dense[handle.index];
+            T *last = m_dense.back();
+            m_dense[dense_index] = last;
+            m_slot_dense[last->m_handle.index] = dense_index;
+            m_dense.pop_back();
+
+            m_slot_dense[handle.index] = UINT32_MAX;
+            m_generations[handle.index]++;
+
+            obj->~T();
+            m_free.push_back(handle.index); // capacity was reserved in grow()
+
+            m_stats.destroyed++;
+            m_stats.live = m_dense.size();
+            return true;
+        }
+
+        bool destroy(T *obj)
+        {
+            return obj != nullptr && destroy(obj->m_handle);
+        }
+
+        // Destroy every live object at once, the memory stays with the pool
+        void clear()
+        {
+            for (T *obj : m_dense)
+            {
+                m_slot_dense[obj->m_handle.index] = UINT32_MAX;
+                m_generations[obj->m_handle.index]++;
+                obj->~T();
+            }
+
+            m_stats.destroyed += m_dense.size();
+            m_dense.clear();
+
+            m_free.clear();
+            for (size_t i = m_generations.size(); i > 0; i--)
+            {
+                m_free.push_back((uint32_t)(i - 1));
+            }
+
+            m_stats.live = 0;
+        }
+
+        // Stamped into every handle, set once by the owning registry before the first create
+        void setTypeIndex(uint32_t type) { m_type = type; }
+        uint32_t getTypeIndex() const { return m_type; }
+
+        size_t size() const { return m_dense.size(); }
+        size_t capacity() const { return m_chunks.size() * CHUNK_SIZE; }
+        const PoolStats &getStats() const { return m_stats; }
+
+        // Dense iteration, order changes on destroy
+        T *operator[](size_t dense_index) const { return m_dense[dense_index]; }
+        typename std::vector<T *>::const_iterator begin() const { return m_dense.begin(); }
+        typename std::vector<T *>::const_iterator end() const { return m_dense.end(); }
+
+    private:
+        struct alignas(T) Slot
+        {
+            unsigned char storage[sizeof(T)];
+        };
+
+        void *slotStorage(uint32_t index)
+        {
+            return m_chunks[index / CHUNK_SIZE][index % CHUNK_SIZE].storage;
+        }
+
+        void grow()
+        {
+            const size_t first = capacity();
+            const size_t new_capacity = first + CHUNK_SIZE;
+            assert(new_capacity < UINT32_MAX && "object pool exhausted");
+
+            m_chunks.push_back(std::unique_ptr<Slot[]>(new Slot[CHUNK_SIZE]));
+
+            // size every bookkeeping array for the full capacity now, create/destroy must not reallocate
+            m_dense.reserve(new_capacity);
+            m_free.reserve(new_capacity);
+            m_generations.resize(new_capacity, 0);
+            m_slot_dense.resize(new_capacity, UINT32_MAX);
+
+            // lowest index on top so fresh objects fill chunks front to back
+            for (size_t i = new_capacity; i > first; i--)
+            {
+                m_free.push_back((uint32_t)(i - 1));
+            }
+
+            m_stats.chunk_allocations++;
+            m_stats.capacity = new_capacity;
+        }
+
+        std::vector<std::unique_ptr<Slot[]>> m_chunks;
+        std::vector<T *> m_dense;
+        std::vector<uint32_t> m_free;
+        std::vector<uint32_t> m_generations;
+        std::vector<uint32_t> m_slot_dense; // slot -> dense index, UINT32_MAX if free
+
+        PoolStats m_stats;
+        uint32_t m_type = 0;
+    };
+}
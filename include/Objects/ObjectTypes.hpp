@@ -0,0 +1,184 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Objects/ObjectPool.hpp"
+#include "Objects/Ball.hpp"
+
+namespace objects
+{
+    /**
+     * Compile time registry of object types
+     *
+     * Every type gets its own ObjectPool. Iteration walks one pool after the other with a generic callback,
+     * so every call inside the loops is a direct (inlinable) call on the concrete type: no virtual calls, no casts.
+     *
+     * An object type derives from Renderable and provides
+     *      void update(size_t display_width, size_t display_height, double delta_t)   any job worker, touches only itself
+     *      void draw()                                                               render thread
+     *      void rasterize(render::SoftRasterizer &raster) const                      render thread, headless renderers instead of draw()
+     *      rectf getBounds() const
+     *      double getKineticEnergy() const                                          any job worker, summed for the metrics
+     *      bool hitTest(vec2f point) const
+     *      void serialize(cJSON *out) const                                          fields sent to the UI
+     *
+     * To add a type, add it to the Scene alias below.
+     */
+    template <typename... Ts>
+    class ObjectStore
+    {
+    public:
+        static constexpr uint32_t TYPE_COUNT = sizeof...(Ts);
+
+        // Position of T in the type list, also stored in every Handle
+        template <typename T>
+        static constexpr uint32_t typeIndex()
+        {
+            constexpr bool matches[] = {std::is_same<T, Ts>::value...};
+            for (uint32_t i = 0; i < TYPE_COUNT; i++)
+            {
+                if (matches[i])
+                {
+                    return i;
+                }
+            }
+            return TYPE_COUNT;
+        }
+
+        ObjectStore()
+        {
+            initTypes(std::index_sequence_for<Ts...>{});
+        }
+
+        ObjectStore(const ObjectStore &) = delete;
+        ObjectStore &operator=(const ObjectStore &) = delete;
+
+        template <typename T>
+        ObjectPool<T> &pool()
+        {
+            static_assert(typeIndex<T>() < TYPE_COUNT, "type is not registered");
+            return std::get<ObjectPool<T>>(m_pools);
+        }
+
+        template <typename T, typename... Args>
+        T *create(Args &&...args)
+        {
+            return pool<T>().create(std::forward<Args>(args)...);
+        }
+
+        // fn(ObjectPool<T> &) for every type
+        template <typename F>
+        void forEachPool(F &&fn)
+        {
+            std::apply([&](auto &...pools)
+                       { (fn(pools), ...); },
+                       m_pools);
+        }
+
+        // fn(T &) for every live object, type by type
+        template <typename F>
+        void forEach(F &&fn)
+        {
+            forEachPool([&](auto &pool)
+                        {
+                            for (auto obj : pool)
+                            {
+                                fn(*obj);
+                            } });
+        }
+
+        // fn(T &) for the object behind the handle, false if the handle is stale
+        template <typename F>
+        bool visit(Handle handle, F &&fn)
+        {
+            return visitTypes(handle, fn, std::index_sequence_for<Ts...>{});
+        }
+
+        bool destroy(Handle handle)
+        {
+            bool ret = false;
+            forEachPool([&](auto &pool)
+                        {
+                            if (handle.type == pool.getTypeIndex())
+                            {
+                                ret = pool.destroy(handle);
+                            } });
+            return ret;
+        }
+
+        void clear()
+        {
+            forEachPool([](auto &pool)
+                        { pool.clear(); });
+        }
+
+        // Room for `count` objects of every type
+        void reserve(size_t count)
+        {
+            forEachPool([&](auto &pool)
+                        { pool.reserve(count); });
+        }
+
+        size_t size() const
+        {
+            return std::apply([](const auto &...pools)
+                              { return (pools.size() + ... + 0); },
+                              m_pools);
+        }
+
+        // Summed over all pools
+        PoolStats getStats() const
+        {
+            PoolStats ret;
+            std::apply([&](const auto &...pools)
+                       { (add(ret, pools.getStats()), ...); },
+                       m_pools);
+            return ret;
+        }
+
+    private:
+        template <size_t... I>
+        void initTypes(std::index_sequence<I...>)
+        {
+            (std::get<I>(m_pools).setTypeIndex((uint32_t)I), ...);
+        }
+
+        template <typename F, size_t... I>
+        bool visitTypes(Handle handle, F &fn, std::index_sequence<I...>)
+        {
+            bool found = false;
+            ((handle.type == I ? found = visitPool(std::get<I>(m_pools), handle, fn) : false), ...);
+            return found;
+        }
+
+        template <typename T, typename F>
+        static bool visitPool(ObjectPool<T> &pool, Handle handle, F &fn)
+        {
+            T *obj = pool.get(handle);
+            if (obj == nullptr)
+            {
+                return false;
+            }
+            fn(*obj);
+            return true;
+        }
+
+        static void add(PoolStats &sum, const PoolStats &stats)
+        {
+            sum.live += stats.live;
+            sum.peak_live += stats.peak_live;
+            sum.capacity += stats.capacity;
+            sum.created += stats.created;
+            sum.destroyed += stats.destroyed;
+            sum.chunk_allocations += stats.chunk_allocations;
+        }
+
+        std::tuple<ObjectPool<Ts>...> m_pools;
+    };
+
+    // Every object type the renderer knows
+    using Scene = ObjectStore<Ball>;
+}
@@ -1,32 +1,41 @@
 #pragma once
+#include <atomic>
 #include <cstddef>
+#include "Math/vec.hpp"
+#include "Math/rect.hpp"
+#include "Objects/ObjectPool.hpp"
 namespace objects
 {
 
-    struct Position
-    {
-        float x;
-        float y;
-    };
+    using Position = vec2f;
 
     class Renderable
     {
     private:
-        static int generator_id;
+        static std::atomic<int> generator_id;
 
         int m_id;
 
+        // Set by the ObjectPool that owns this object
+        Handle m_handle;
+
+        template <typename, size_t>
+        friend class ObjectPool;
+
     protected:
-        float m_x;
-        float m_y;
+        vec2f m_position;
 
         Renderable();
 
+        // Restore an object with a known id (snapshots), later ids continue after it
+        explicit Renderable(int id);
+
     public:
-        virtual void
-        render(const size_t displayWidth, const size_t displayHeight, const double delta_t) = 0;
-        Position getPosition();
+        // Common state of every object type, the behaviour (update, draw, ...) is looked up at compile time,
+        // see Objects/ObjectTypes.hpp for what a type has to provide
+        Position getPosition() const;
         int getId() const;
+        Handle getHandle() const;
     };
 
 }
\ No newline at end of file
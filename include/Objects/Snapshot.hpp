@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace objects
+{
+    /**
+     * Scene snapshot file, little endian, fixed layout:
+     *
+     *      SnapshotHeader (64 bytes)
+     *      BallRecord[count]  (record_size bytes each)
+     *
+     * Newer versions may only append fields (to the header and to every record), readers accept any version >= 1 with
+     * header_size / record_size at least the sizes known here and skip what they do not know. A change that breaks the
+     * layout needs a new magic. Both sizes stay multiples of alignof(BallRecord), so records can be read in place.
+     * Files are mapped and read in place, there is no parsing step.
+     */
+    const char SNAPSHOT_MAGIC[8] = {'W', 'U', 'I', 'S', 'N', 'A', 'P', '\0'};
+    const uint32_t SNAPSHOT_VERSION = 1; // written, every version from 1 up is read
+
+    struct SnapshotHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint32_t record_size;
+        uint32_t scene_width; // display size the scene was saved from
+        uint32_t scene_height;
+        uint32_t reserved0;
+        uint64_t count;
+        uint8_t reserved[24];
+    };
+    static_assert(sizeof(SnapshotHeader) == 64, "snapshot header layout changed");
+
+    struct BallRecord
+    {
+        int32_t id;
+        float x, y;
+        float vx, vy; // px / s
+        float radius;
+        float r, g, b, a; // ALLEGRO_COLOR as is
+    };
+    static_assert(sizeof(BallRecord) == 40, "snapshot record layout changed");
+
+    // Write header and records in one go, false (and logged) on any I/O error
+    bool writeSnapshot(const std::string &path, const BallRecord *records, size_t count, uint32_t scene_width, uint32_t scene_height);
+
+    /**
+     * Read only mapping of a snapshot file, records point straight into the mapping
+     */
+    class SnapshotFile
+    {
+    public:
+        SnapshotFile() = default;
+        ~SnapshotFile();
+
+        SnapshotFile(const SnapshotFile &) = delete;
+        SnapshotFile &operator=(const SnapshotFile &) = delete;
+
+        // Map and validate, false (and logged) if the file is missing, truncated or its layout can not be read in place
+        bool open(const std::string &path);
+        void close();
+
+        const SnapshotHeader &getHeader() const;
+        size_t getCount() const;
+
+        // Records may be larger than BallRecord in newer versions, always step by the header's record_size
+        const BallRecord &getRecord(size_t index) const;
+
+    private:
+        const uint8_t *m_data = nullptr;
+        size_t m_size = 0;
+    };
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Math/rect.hpp"
+#include "Objects/ObjectPool.hpp"
+
+namespace objects
+{
+    /**
+     * Broad phase index over object bounds
+     *
+     * Uniform grid over the display area, every object is filed under the cell holding the center of its bounds
+     * (objects outside the area go to the nearest border cell). Queries widen their search by the largest half extent
+     * ever inserted, so one cell per object is enough and moving inside a cell only overwrites the stored bounds.
+     *
+     * Entries are addressed by the pool slot and type of their Handle, so update / remove are O(1) and never search.
+     * Cells are intrusive lists threaded through the entries, so once reserve()d for the object count, filing and moving
+     * objects never allocates.
+     * Query results are appended to a caller owned vector, reuse it to keep queries allocation free.
+     *
+     * Not thread safe, the owner has to lock (the renderer keeps it under the same lock as its object pool).
+     */
+    class SpatialGrid
+    {
+    public:
+        // type_count: number of object types sharing the grid, handles of different types may share a slot index
+        explicit SpatialGrid(float cell_size = 64, uint32_t type_count = 1);
+
+        // Set the indexed area, rebuilds all cells
+        void resize(float width, float height);
+
+        // Make room for objects in the first `count` pool slots of every type without allocating
+        void reserve(size_t count);
+
+        // Insert the object or move it to its new bounds
+        void update(Handle handle, const rectf &bounds);
+        void remove(Handle handle);
+        void clear();
+
+        // Objects whose bounds contain the point
+        size_t queryPoint(vec2f point, std::vector<Handle> &out) const;
+
+        // Objects whose bounds intersect the area
+        size_t queryRect(const rectf &area, std::vector<Handle> &out) const;
+
+        // Up to k objects with the closest bound centers, nearest first
+        size_t nearestK(vec2f point, size_t k, std::vector<Handle> &out) const;
+
+        size_t size() const;
+
+    private:
+        struct Entry
+        {
+            Handle handle;
+            rectf bounds;
+            uint32_t cell = UINT32_MAX; // UINT32_MAX if not in the grid
+            uint32_t prev = UINT32_MAX; // neighbours in the cell's list
+            uint32_t next = UINT32_MAX;
+        };
+
+        uint32_t entryOf(Handle handle) const;
+        uint32_t cellOf(vec2f point) const;
+        void cellRange(const rectf &area, int &x0, int &y0, int &x1, int &y1) const;
+        void link(uint32_t slot, uint32_t cell);
+        void unlink(uint32_t slot);
+
+        uint32_t m_type_count;
+        float m_cell_size;
+        float m_inv_cell_size;
+        int m_cols = 1;
+        int m_rows = 1;
+
+        // largest half width / height inserted since the last clear
+        float m_max_extent = 0;
+
+        std::vector<Entry> m_entries; // by pool slot index * type count + type
+        std::vector<uint32_t> m_cells; // first entry of every cell, UINT32_MAX if empty
+        size_t m_size = 0;
+    };
+}
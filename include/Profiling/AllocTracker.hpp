@@ -0,0 +1,104 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Allocation tracker
+ * @details Opt-in (cmake -DWUI_ALLOC_TRACKING=ON), hooks the global allocator and counts every allocation
+ *
+ * Allocations are attributed to the tag of the calling thread, set with WUI_ALLOC_SCOPE("subsystem.phase").
+ * WUI_ALLOC_FREE_SCOPE("name") declares a region that must not allocate: violations are counted,
+ * in strict mode (--alloc-strict) the process aborts on the first one with the region name on stderr.
+ *
+ * On glibc malloc / calloc / realloc / memalign are interposed (covers operator new and C libraries like cJSON),
+ * elsewhere only the global operator new is replaced.
+ *
+ * Without the option all macros compile to nothing and the allocator is untouched.
+ */
+namespace alloc
+{
+    // Tags beyond this count are attributed to "other"
+    const size_t MAX_TAGS = 64;
+
+    struct Counter
+    {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+    };
+
+    // True if the build has the hooks
+    bool isEnabled();
+
+    // Abort on allocations inside allocation-free regions
+    void setStrict(bool strict);
+
+    // Allocations that happened inside allocation-free regions so far
+    uint64_t getViolationCount();
+
+    // Cumulative counters per tag since start
+    void logReport();
+
+    // Cumulative counter and name of a tag index (0 .. MAX_TAGS - 1), unused tags read as zero
+    Counter getCounter(uint32_t tag);
+    const char *getTagName(uint32_t tag);
+
+    // Tag index for a name (must outlive the process, e.g. a literal), registers it on first use
+    uint32_t tagIndex(const char *name);
+
+    // Swap the tag of the calling thread, returns the previous one
+    uint32_t swapTag(uint32_t tag);
+
+    // Enter / leave an allocation-free region on the calling thread, returns the previous region (nullptr if none)
+    const char *swapAllocFree(const char *name);
+
+    class TagScope
+    {
+    public:
+        explicit TagScope(uint32_t tag) : m_previous(swapTag(tag)) {}
+        ~TagScope() { swapTag(m_previous); }
+
+    private:
+        uint32_t m_previous;
+    };
+
+    class AllocFreeScope
+    {
+    public:
+        explicit AllocFreeScope(const char *name) : m_previous(swapAllocFree(name)) {}
+        ~AllocFreeScope() { swapAllocFree(m_previous); }
+
+    private:
+        const char *m_previous;
+    };
+
+    /**
+     * Per frame view of the counters, one instance per render loop
+     * Every interval logs the average allocations per frame (all threads, by tag) since the last log
+     */
+    class FrameCounter
+    {
+    public:
+        void frameEnd(size_t renderer_index);
+
+    private:
+        Counter m_last[MAX_TAGS];
+        Counter m_window[MAX_TAGS];
+        uint64_t m_frames = 0;
+        std::chrono::steady_clock::time_point m_window_start = std::chrono::steady_clock::now();
+    };
+}
+
+#define WUI_ALLOC_CONCAT_INNER(a, b) a##b
+#define WUI_ALLOC_CONCAT(a, b) WUI_ALLOC_CONCAT_INNER(a, b)
+
+#ifdef WUI_ALLOC_TRACKING
+// the tag lookup happens once per call site
+#define WUI_ALLOC_SCOPE(name)                                                                \
+    static const uint32_t WUI_ALLOC_CONCAT(_alloc_tag_, __LINE__) = alloc::tagIndex(name); \
+    alloc::TagScope WUI_ALLOC_CONCAT(_alloc_scope_, __LINE__)(WUI_ALLOC_CONCAT(_alloc_tag_, __LINE__))
+#define WUI_ALLOC_FREE_SCOPE(name) alloc::AllocFreeScope WUI_ALLOC_CONCAT(_alloc_free_scope_, __LINE__)(name)
+#else
+#define WUI_ALLOC_SCOPE(name) (void)0
+#define WUI_ALLOC_FREE_SCOPE(name) (void)0
+#endif
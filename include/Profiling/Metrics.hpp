@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+
+/**
+ * @brief Process metrics, served in Prometheus text format
+ * @details Counters and histograms keep one slot block per thread: recording is a plain relaxed load + store
+ * on memory only the calling thread writes, no atomic read-modify-write, no lock, no shared cache line.
+ * A scrape sums the blocks of all threads that ever recorded, it never waits on them.
+ *
+ * Metrics are meant to be defined once at namespace scope next to the code that records them:
+ *
+ *      metrics::Counter m_frames_metric("wui_frames_total", "Frames presented");
+ *      ...
+ *      m_frames_metric.inc();
+ *
+ * startServer() answers every connection with the current values as a minimal HTTP response
+ * (curl, Prometheus), on a loopback TCP port or a Unix domain socket.
+ */
+namespace metrics
+{
+    // Slots per thread block, every counter takes one, a histogram one per bucket + 2
+    const size_t MAX_SLOTS = 256;
+
+    class Counter
+    {
+    public:
+        Counter(const char *name, const char *help);
+
+        void inc(uint64_t value = 1);
+
+        // Summed over all threads
+        uint64_t get() const;
+
+    private:
+        uint32_t m_slot;
+    };
+
+    // Last value wins, for states (objects alive) rather than events
+    class Gauge
+    {
+    public:
+        Gauge(const char *name, const char *help);
+
+        void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+        void add(int64_t delta) { m_value.fetch_add(delta, std::memory_order_relaxed); }
+        int64_t get() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> m_value{0};
+    };
+
+    class Histogram
+    {
+    public:
+        static const size_t MAX_BUCKETS = 16;
+
+        // bounds: ascending upper bounds (le), +Inf is implicit
+        Histogram(const char *name, const char *help, std::initializer_list<double> bounds);
+
+        void observe(double value);
+
+    private:
+        friend void writeText(std::string &out);
+
+        double m_bounds[MAX_BUCKETS];
+        size_t m_bucket_count = 0;
+        uint32_t m_slot; // buckets, then +Inf, then sum (double bits)
+    };
+
+    // Extra lines appended to every scrape, for values owned elsewhere (e.g. allocation counters)
+    void addCollector(std::function<void(std::string &out)> collector);
+
+    // Current values of every metric in Prometheus text format
+    void writeText(std::string &out);
+
+    // Serve writeText on "unix:/path/to/socket" or a loopback TCP port ("9464"), false (and logged) if it can not listen
+    bool startServer(const std::string &address);
+    void stopServer();
+}
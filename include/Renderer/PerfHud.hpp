@@ -0,0 +1,90 @@
+#pragma once
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace render
+{
+    // Render thread measurements of one frame, handed to PerfHud::record
+    struct FrameTimings
+    {
+        double total_ms = 0; // start of the frame until after the flip
+        double ui_ms = 0;    // OSR copy, tile scan and upload
+        double simulate_ms = 0;
+        double draw_ms = 0; // grid, culling, draw calls and BallInfo serialization
+        double send_ms = 0;
+        double present_ms = 0; // UI blend and flip
+
+        size_t objects = 0;
+        size_t culled = 0;
+        size_t ui_copied_bytes = 0;
+        size_t ui_uploaded_bytes = 0;
+        size_t ui_events_in_flight = 0; // BallInfo messages the page has not acknowledged yet
+    };
+
+    /**
+     * Diagnostics overlay drawn natively by the renderer, not through the UI it measures
+     *
+     * Hidden it only costs the visibility check in record() / draw().
+     * Shown, the text is rebuilt at most every TEXT_INTERVAL from the averages since the last rebuild
+     * and rendered once into a cached bitmap (the builtin bitmap font, glyphs come from its atlas),
+     * so a frame is one bitmap blit plus one line strip for the frame time graph.
+     *
+     * All methods must be called from the render thread, the bitmaps belong to its display.
+     */
+    class PerfHud
+    {
+    public:
+        static const size_t HISTORY = 180; // frames in the graph
+        static constexpr std::chrono::milliseconds TEXT_INTERVAL{250};
+
+        PerfHud() = default;
+        ~PerfHud();
+
+        PerfHud(const PerfHud &) = delete;
+        PerfHud &operator=(const PerfHud &) = delete;
+
+        // Thread safe
+        void toggle();
+        void setVisible(bool visible);
+        bool isVisible() const;
+
+        void record(const FrameTimings &frame);
+
+        // Top left corner at (x, y)
+        void draw(float x, float y);
+
+        // Free font and bitmaps, before the display goes away
+        void release();
+
+    private:
+        void rebuildText();
+
+        std::atomic<bool> m_visible{false};
+        bool m_active = false; // drawn last frame, render thread only
+
+        ALLEGRO_FONT *m_font = nullptr;
+        ALLEGRO_BITMAP *m_text_bitmap = nullptr;
+
+        // frame times (ms), ring buffer
+        float m_history[HISTORY] = {};
+        size_t m_history_next = 0;
+
+        // sums since the last text rebuild
+        FrameTimings m_sum;
+        size_t m_sum_frames = 0;
+        FrameTimings m_last;
+        double m_max_frame_ms = 0;
+
+        std::chrono::steady_clock::time_point m_last_rebuild;
+        size_t m_last_input_events = 0;
+
+        std::vector<std::string> m_lines;
+    };
+}
@@ -7,8 +7,16 @@
 #include <mutex>
 #include <vector>
 #include <thread>
+#include <chrono>
+#include <string>
 
-#include "Objects/Renderable.hpp"
+#include "Objects/ObjectTypes.hpp"
+#include "Objects/SpatialGrid.hpp"
+#include "Objects/IdIndex.hpp"
+#include "Renderer/UiLayer.hpp"
+#include "Renderer/SoftRaster.hpp"
+#include "Renderer/PerfHud.hpp"
+#include "Profiling/AllocTracker.hpp"
 
 #include "webUiBinding.hpp"
 #include "webUiTypes.hpp"
@@ -19,13 +27,48 @@ namespace render
     const size_t BASE_WIDTH = 640;
     const size_t BASE_HEIGHT = 480;
 
+    // BallInfo messages the page may have not acknowledged yet before frames stop sending, 0 = unlimited
+    // The UI acks every processed message (BallInfoAck), while it lags the newest state replaces the skipped ones
+    void setMaxUiEventsInFlight(size_t count);
+
+    // UI render scale new renderers start with, see Renderer::setUiScale
+    const float MIN_UI_SCALE = 0.25f;
+    void setDefaultUiScale(float scale);
+
+    // UI viewport new renderers start with, see Renderer::setUiViewport
+    void setDefaultUiViewport(const recti &viewport);
+
+    // Name of the layer every renderer has, the one setUiScale / setUiViewport and BallInfo address
+    const char *const MAIN_UI_LAYER = "ui";
+
+    // Additional UI layer (own tab, z-order, placement, rate cap) of every renderer created afterwards, the main layer sits at z 0
+    void addDefaultUiLayer(const UiLayerConfig &config);
+
+    // Whether new renderers keep a spare tab per UI layer loading in the background, so restartWui takes it over
+    // instead of waiting for the page to load. Costs one more tab (renderer process memory, page timers) per layer
+    void setDefaultUiPrewarm(bool prewarm);
+
+    // Whether new renderers start with the performance HUD shown
+    void setDefaultPerfHudVisible(bool visible);
+
+    // New renderers draw into a memory bitmap instead of opening a window: no display, no input, the tab still renders
+    void setDefaultHeadless(bool headless);
+
+    // Whether new headless renderers draw with the SoftRasterizer (default) instead of Allegro's software primitives
+    void setDefaultSoftRaster(bool soft_raster);
+
+    // Whether new windows wait for vertical sync when flipping, off lets frame times show the actual work (stress runs)
+    void setDefaultVsync(bool vsync);
+
     /**
      * A Renderer owns a display and a list of objects that are render-able
      * The display itself is the event source for closing the window, resizing, etc.
      *
      * Multiple renderer may be instanced and started at the same time.
+     * Each one owns its own display, render thread, UI layers (one OSR tab each) and set of objects.
+     * Use createRenderer() so the input system can route events to the window they belong to.
      *
-     * Any instance also has an OCR buffer for testing the WGUI system library
+     * Any instance also has an OSR buffer for testing the WGUI system library
      *
      */
     class Renderer
@@ -39,15 +82,25 @@ namespace render
         size_t width = BASE_WIDTH;
         size_t fps = BASE_FPS;
 
+        // Index in the renderer registry, used for the window title and placement
+        size_t m_index = 0;
+
     public:
-        wui::wui_tab_id_t wui_tab_id = 0;
-        Renderer();
+        Renderer(size_t index = 0, size_t width = BASE_WIDTH, size_t height = BASE_HEIGHT);
         ~Renderer();
 
     private:
         // Required always, physical display of allegro
         ALLEGRO_DISPLAY *m_display = NULL;
 
+        // Headless renderers draw into this memory bitmap instead, m_display stays NULL
+        bool m_headless = false;
+        ALLEGRO_BITMAP *m_headless_target = NULL;
+
+        // Headless only: objects and UI layers are rasterized straight into the locked target
+        bool m_soft_raster = false;
+        SoftRasterizer m_rasterizer;
+
         // Display event loop, closing window, etc
         ALLEGRO_EVENT_QUEUE *m_event_queue = NULL; // Display event loop
 
@@ -63,41 +116,219 @@ namespace render
         std::thread m_render_thread;
         void renderLoop();
 
-        // Pointer to the current display bitmap, void* to RGBA( width * height * 4)
-        void *wui_rgba_bitmap = nullptr;
+        // Per instance frame state, kept here so several renderers do not share it
+        std::chrono::high_resolution_clock::time_point m_last_frame_time;
+        bool m_sent_zero_balls = false;
+        std::atomic<size_t> m_culled_objects{0}; // objects hidden behind opaque UI last frame
+        bool m_open_wui_on_start = true;
+        bool m_first_ui_frame = false; // startup timeline ends with the first frame showing UI
+        alloc::FrameCounter m_frame_allocations; // reports only in WUI_ALLOC_TRACKING builds
+
+        // BallInfo flow control, sequence numbers of the last sent and the last acknowledged message
+        std::atomic<uint64_t> m_info_sent{0};
+        std::atomic<uint64_t> m_info_acked{0};
+        std::chrono::steady_clock::time_point m_info_stalled_since; // render thread only
+        bool m_info_stalled = false;
+        std::atomic<size_t> m_info_skipped{0}; // frames whose BallInfo was dropped because the UI lagged
+
+        // Whether this frame may send a BallInfo, render thread only
+        bool uiReadyForInfo();
+        int handleInfoAck(const cJSON *load, cJSON *retval, std::string &exc);
+
+        // The page pushes whether an editable element has focus whenever focus changes
+        int handleTextInputMode(UiLayer &layer, const cJSON *load, cJSON *retval, std::string &exc);
 
-    private: // OSR buffer rendering
-        // Main off screen rendering buffer where the CEF will render into
-        ALLEGRO_BITMAP *m_osr_buffer = NULL;
-        std::mutex m_l_osr_buffer_lock;
+        // The page asks which layer it is rendered for, answers {"name", "z"}
+        int handleLayerRole(const UiLayer &layer, const cJSON *load, cJSON *retval, std::string &exc);
+
+        // Everything a layer's page may send but LayerRole, which a spare tab needs while loading already
+        void registerUiListeners(UiLayer *layer, wui::wui_tab_id_t tab_id);
+        void unregisterUiListeners(const UiLayer *layer, wui::wui_tab_id_t tab_id);
+
+        // Give every layer without one a spare tab, when prewarming is on
+        void prewarmWui();
+
+    private: // UI layers
+        // Sorted by z (bottom first), fixed after construction, so iterating needs no lock
+        std::vector<std::unique_ptr<UiLayer>> m_layers;
+        UiLayer *m_main_layer = nullptr;
+
+        // Layer keys go to, the one the last press went to
+        std::atomic<UiLayer *> m_focused_layer{nullptr};
+
+        bool m_prewarm_ui = false;
+
+        // Native diagnostics overlay, drawn over the UI
+        PerfHud m_hud;
+
+        // this renderer's share of the wui_objects_alive gauge, render thread only
+        size_t m_reported_objects = 0;
+        int64_t m_reported_energy = 0; // same for wui_scene_kinetic_energy
+
+        // per chunk results of the simulation step's energy sum (deterministic mode), reserved before its alloc free scope
+        std::vector<double> m_energy_partials;
+
+        // Every frame's timings while capturing, see takeFrameTimings
+        std::atomic<bool> m_capture_timings{false};
+        std::mutex m_l_captured_timings;
+        std::vector<FrameTimings> m_captured_timings;
 
     private:
         // Register of all game objects that are to be rendered
         // Note: Consider moving this into a entity management system and reference that system here
         std::mutex m_l_renderables;
-        std::vector<std::shared_ptr<objects::Renderable>> m_renderables;
+        objects::Scene m_scene;
+
+        // Broad phase over m_scene, refreshed while drawing, same lock
+        objects::SpatialGrid m_grid{64, objects::Scene::TYPE_COUNT};
+        std::vector<objects::Handle> m_query_scratch;
+        std::vector<vec2f> m_pick_points; // centers of the objects pickObject hit, packed for batch::nearest
+
+        // Rubber band selection, may hold stale handles until the next select / delete
+        std::vector<objects::Handle> m_selection;
+
+        // Object id (as known to the UI) -> handle, same lock
+        objects::IdIndex m_id_index;
+
+        // Bookkeeping shared by every way objects come and go, m_l_renderables must be held
+        template <typename T>
+        void insertObject(T *obj);
+        bool eraseObject(objects::Handle handle);
+        size_t eraseAllObjects();
+
+        // Size the grid for every slot the pools currently have, m_l_renderables must be held
+        void reserveGrid();
+
+    private: // UI commands, registered as event listeners on the tab
+        struct Command
+        {
+            const char *name;
+
+            // Called with m_l_renderables held, fills result. On error returns -1 and sets exc
+            int (Renderer::*apply)(const cJSON *load, cJSON *result, std::string &exc);
+        };
+        static const Command COMMANDS[];
+
+        // Lock once and apply a single command
+        int handleCommand(const Command &command, const cJSON *load, cJSON *retval, std::string &exc);
+
+        // {"commands": [{"command": <name>, "payload": {...}}, ...]}, all applied under one lock
+        int handleBatch(const cJSON *load, cJSON *retval, std::string &exc);
+
+        int applyDeleteBall(const cJSON *load, cJSON *result, std::string &exc);
+        int applyDeleteBalls(const cJSON *load, cJSON *result, std::string &exc);
+        int applySpawnBalls(const cJSON *load, cJSON *result, std::string &exc);
+        int applyClearAll(const cJSON *load, cJSON *result, std::string &exc);
 
     public:
         // FrameListener interface
         ALLEGRO_DISPLAY *getDisplay() const;
 
         void shutdown();
-        void start();
+
+        // Start the render thread, open_wui creates the offscreen tab from it once the display exists
+        // (pass false if the tab is created elsewhere, e.g. concurrently during startup)
+        void start(bool open_wui = true);
         void waitUntilEnd();
 
-        int handleDeleteObject(const cJSON *load, cJSON *retval, std::string &exc);
+        bool isRunning() const;
+        bool isHeadless() const;
+        size_t getIndex() const;
+
+        // Tab of the main layer
+        wui::wui_tab_id_t getWuiTabId() const;
 
+        // Create the offscreen tab of every layer that has none, or take over its prewarmed spare
         void restartWui();
 
+        // Close the offscreen tabs, prewarmed spares stay for the next restart
+        void closeWui();
+
+        // Close the prewarmed spare tabs
+        void closeSpareWui();
+
+        // Layers from the top down, for input hit testing
+        std::vector<UiLayer *> getUiLayersTopDown() const;
+
+        // Topmost layer with a visible pixel at the window position in its last frame, nullptr if the scene is visible there
+        UiLayer *getUiLayerAt(vec2i window_pos) const;
+
+        // Layer that receives keys (if it has a text field focused), the main layer until a press went elsewhere
+        UiLayer *getFocusedUiLayer() const;
+        void focusUiLayer(UiLayer *layer);
+
+        // Render the tab at a fraction of the window resolution and stretch it when compositing,
+        // trades UI sharpness for CEF raster and upload time on large windows. Clamped to [MIN_UI_SCALE, 1],
+        // applied by the render thread on its next frame. The page lays out in UI pixels, so it appears magnified
+        void setUiScale(float scale);
+        float getUiScale() const;
+
+        // Restrict the tab to a part of the window (side panel, HUD strip), the surface, copy, upload and blend
+        // then scale with the panel instead of the window, and mouse input outside of it never reaches WUI.
+        // Width / height <= 0 extend to the right / bottom window edge, so the default {} is the whole window.
+        // Applied by the render thread on its next frame
+        void setUiViewport(const recti &viewport);
+
+        // Current viewport in window pixels
+        recti getUiViewport() const;
+
         // object management
     public:
-        void addObject(std::shared_ptr<objects::Renderable> renderable)
-        {
-            m_l_renderables.lock();
-            m_renderables.push_back(renderable);
-            m_l_renderables.unlock();
-        }
+        objects::Handle spawnBall(int x, int y);
+
+        // Release every object at once, pool memory is kept for the next spawns
+        void clearObjects();
+
+        // Preallocate so spawning up to `count` objects never touches the global allocator
+        void reserveObjects(size_t count);
+
+        size_t getObjectCount();
+        objects::PoolStats getPoolStats();
+
+        // Spatial queries, in display coordinates
+        // Ball under the point (nearest center if several overlap), invalid handle if there is none
+        objects::Handle pickObject(vec2f point);
+
+        // Up to k objects closest to the point, nearest first
+        std::vector<objects::Handle> nearestObjects(vec2f point, size_t k);
+
+        bool destroyObject(objects::Handle handle);
+
+        // Replace the selection with every object touching the area, returns the selected count
+        size_t selectObjects(const rectf &area);
+        void deleteSelected();
+
+        // Scene snapshots (Objects/Snapshot.hpp), loading replaces all objects
+        bool saveSnapshot(const std::string &path);
+        bool loadSnapshot(const std::string &path);
+
+        // Show / hide the performance HUD, thread safe
+        void togglePerfHud();
+
+        // Keep the timings of every frame until taken, for measurements over many frames (stress harness)
+        void setFrameTimingCapture(bool enabled);
+        std::vector<FrameTimings> takeFrameTimings();
+
+        // Objects skipped last frame because opaque UI covered them completely
+        size_t getCulledObjectCount() const;
+
+        // BallInfo backpressure: messages not yet acknowledged by the page, frames skipped because of it (total)
+        size_t getUiEventsInFlight() const;
+        size_t getSkippedUiUpdates() const;
     };
 
-    extern Renderer renderer;
+    // Renderer registry
+    // Renderers created here live until the process exits, so returned pointers stay valid
+
+    // Create (but do not start) a new renderer
+    Renderer *createRenderer(size_t width = BASE_WIDTH, size_t height = BASE_HEIGHT);
+
+    // All renderers created so far
+    std::vector<Renderer *> getRenderers();
+
+    // Renderer owning the given display, nullptr if none
+    Renderer *getRenderer(const ALLEGRO_DISPLAY *display);
+
+    // Renderer whose window had focus last, falls back to the first one
+    Renderer *getFocusedRenderer();
 }
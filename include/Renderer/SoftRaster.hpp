@@ -0,0 +1,83 @@
+#pragma once
+
+#include <allegro5/allegro.h>
+#include "Math/rect.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace render
+{
+    class UiLayer;
+
+    /**
+     * CPU rasterizer for headless renderers, replaces Allegro's generic software primitives on memory bitmaps
+     *
+     * Objects add anti-aliased filled circles during the draw phase, they are binned into TILE_SIZE x TILE_SIZE screen tiles
+     * right away. render() then hands the tiles to the job workers: each clears its tile, draws its circles in the order they
+     * were added (solid spans filled 4 pixels at a time, only the anti-aliased edge pixels are computed one by one)
+     * and blends the UI layers' last frames on top, so every pixel is written while it is still in cache.
+     *
+     * Pixels are ALLEGRO_PIXEL_FORMAT_ARGB_8888 (0xAARRGGBB) with premultiplied alpha, as Allegro's default blender and CEF use them.
+     * Render thread only, the workers only run inside render().
+     */
+    class SoftRasterizer
+    {
+    public:
+        static const size_t TILE_SIZE = 64;
+
+        SoftRasterizer() = default;
+
+        SoftRasterizer(const SoftRasterizer &) = delete;
+        SoftRasterizer &operator=(const SoftRasterizer &) = delete;
+
+        // Target size in pixels, drops the circles added so far
+        void resize(size_t width, size_t height);
+
+        // Queue a circle for the next render, color as Allegro maps it (premultiplied)
+        void addCircle(vec2f center, float radius, ALLEGRO_COLOR color);
+
+        // Clear dst (width x height ARGB_8888, pitch in bytes), draw the queued circles and blend the layers over them bottom first
+        // Empties the queue
+        void render(uint8_t *dst, ptrdiff_t pitch, const std::vector<std::unique_ptr<UiLayer>> &layers);
+
+        // Circles drawn by the last render
+        size_t getCircleCount() const;
+
+        // Premultiplied src over dst, count pixels
+        static void blendSpan(uint32_t *dst, const uint32_t *src, size_t count);
+
+        // Premultiplied src over a single pixel
+        static uint32_t blendPixel(uint32_t dst, uint32_t src)
+        {
+            const uint32_t k = 256 - (src >> 24);
+            const uint32_t rb = (((dst & 0x00FF00FF) * k) >> 8) & 0x00FF00FF;
+            const uint32_t ag = (((dst >> 8) & 0x00FF00FF) * k) & 0xFF00FF00;
+            return src + (rb | ag);
+        }
+
+    private:
+        struct Circle
+        {
+            float x;
+            float y;
+            float radius;
+            uint32_t color;
+        };
+
+        void drawCircle(const Circle &circle, uint8_t *dst, ptrdiff_t pitch, const recti &tile) const;
+
+        size_t m_width = 0;
+        size_t m_height = 0;
+        size_t m_tiles_x = 0;
+        size_t m_tiles_y = 0;
+
+        std::vector<Circle> m_circles;
+
+        // Per tile, indices into m_circles in the order they were added. Cleared, never shrunk, so a steady scene stops allocating
+        std::vector<std::vector<uint32_t>> m_bins;
+
+        size_t m_drawn = 0;
+    };
+}
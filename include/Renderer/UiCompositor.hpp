@@ -0,0 +1,120 @@
+#pragma once
+
+#include <allegro5/allegro.h>
+#include "Math/rect.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace render
+{
+    enum class TileState : uint8_t
+    {
+        TRANSPARENT, // every pixel alpha == 0, never uploaded or drawn
+        OPAQUE,      // every pixel alpha == 255
+        MIXED,
+    };
+
+    /**
+     * Composites the WUI offscreen frame over the scene
+     *
+     * The frame is split into TILE_SIZE x TILE_SIZE tiles. Every update scans the CEF frame once (SIMD),
+     * copying it into a shadow buffer while classifying each tile by its alpha range and detecting changes.
+     * Only changed, non transparent tiles are uploaded to the GPU bitmap, and only non transparent tiles are drawn.
+     * The bitmap is linearly filtered so the frame may be drawn scaled up (see Renderer::setUiScale).
+     *
+     * Changed tiles also refresh a hit mask, one bit per HIT_CELL x HIT_CELL block telling whether any pixel of it is visible.
+     * Input asks it (isTransparentAt) before a click goes to WUI, so clicks over transparent UI never wait for a CEF round trip.
+     *
+     * All methods but isTransparentAt must be called from the render thread, the bitmap belongs to its display.
+     */
+    class UiCompositor
+    {
+    public:
+        static const size_t TILE_SIZE = 64;
+        static const size_t HIT_CELL = TILE_SIZE / 8; // 8 x 8 cells per tile, one 64 bit word
+
+        UiCompositor() = default;
+        ~UiCompositor();
+
+        UiCompositor(const UiCompositor &) = delete;
+        UiCompositor &operator=(const UiCompositor &) = delete;
+
+        // (Re)create bitmap and shadow buffer, everything starts out transparent. 0x0 releases all resources
+        void resize(size_t width, size_t height);
+
+        // Take a new frame (BGRA, width * height * 4, premultiplied as CEF paints it), nullptr clears the UI
+        void update(const void *bgra);
+
+        // Blend all non transparent tiles onto the current target with the top left corner at (x, y)
+        // scale != 1 stretches the frame (linear filtering), for UIs rendered at a lower resolution than the window
+        void draw(float x, float y, float scale = 1.0f);
+
+        // Blend the last frame over dst (window pixels, ARGB_8888, pitch in bytes) with its top left corner at origin,
+        // touching only the pixels of area. CPU counterpart of draw for the software rasterizer (see SoftRasterizer),
+        // transparent tiles are skipped, opaque ones copied. scale != 1 samples the nearest UI pixel
+        // Safe to call for disjoint areas from several threads as long as no update runs
+        void blendInto(uint8_t *dst, ptrdiff_t pitch, const recti &area, vec2i origin, float scale = 1.0f) const;
+
+        // True if every tile touching the area (UI pixel coordinates) is opaque, i.e. the scene below is invisible
+        // O(1), backed by a summed area table of opaque tiles rebuilt only when a tile changes state
+        bool isRectOpaque(const rectf &area) const;
+
+        // At least one tile is not transparent
+        bool hasVisibleTiles() const;
+
+        // True if no pixel of the last frame is visible in the hit cell around pos (UI pixel coordinates), or pos is outside the UI
+        // Thread safe, reads the mask published by the last update
+        bool isTransparentAt(vec2f pos) const;
+
+        TileState getTileState(size_t tile_x, size_t tile_y) const;
+        size_t getTilesX() const;
+        size_t getTilesY() const;
+
+        // Bytes uploaded to the GPU by the last update
+        size_t getUploadedBytes() const;
+
+        // Bytes of the CEF frame scanned into the shadow buffer by the last update
+        size_t getCopiedBytes() const;
+
+    private:
+        // returns true if any tile in the row changed its state, pixels_changed is set if any pixel did
+        bool scanTileRow(const uint32_t *src, size_t tile_y, bool &pixels_changed);
+        void uploadDirtyTiles();
+
+        // Cells of a tile with at least one visible pixel, from the shadow buffer
+        uint64_t buildHitCells(size_t tile_x, size_t tile_y, TileState state) const;
+
+        // Copy m_hit_cells for isTransparentAt
+        void publishHitMask();
+
+        size_t m_width = 0;
+        size_t m_height = 0;
+        size_t m_tiles_x = 0;
+        size_t m_tiles_y = 0;
+
+        ALLEGRO_BITMAP *m_bitmap = nullptr;
+
+        // Last frame as it was handed to us, the GPU bitmap mirrors it for non transparent tiles
+        std::vector<uint32_t> m_shadow;
+
+        std::vector<TileState> m_tiles;
+        std::vector<uint8_t> m_dirty; // tile changed and needs to be uploaded
+
+        // Per tile, bit cell_y * 8 + cell_x set if the cell has a visible pixel. Render thread copy and the one input reads
+        std::vector<uint64_t> m_hit_cells;
+        std::vector<uint64_t> m_hit_mask;
+        size_t m_hit_width = 0;
+        size_t m_hit_height = 0;
+        size_t m_hit_tiles_x = 0;
+        mutable std::mutex m_l_hit_mask;
+
+        // (tiles_x + 1) * (tiles_y + 1) prefix sums of opaque tiles
+        std::vector<uint32_t> m_opaque_sat;
+        void rebuildOpacityMask();
+
+        size_t m_uploaded_bytes = 0;
+        size_t m_copied_bytes = 0;
+    };
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+#include "Math/rect.hpp"
+#include "Renderer/UiCompositor.hpp"
+
+#include "webUiTypes.hpp"
+
+namespace render
+{
+    // Placement of one UI layer, see render::addDefaultUiLayer
+    struct UiLayerConfig
+    {
+        std::string name;   // the page asks for it (LayerRole) to know what to show, e.g. "hud" or "console"
+        int z = 0;          // higher is drawn later (on top) and hit tested first
+        recti viewport;     // window pixels, width / height <= 0 extend to the window edge
+        float scale = 1.0f; // tab resolution relative to the viewport, see Renderer::setUiScale
+        size_t max_fps = 0; // frames taken from the tab per second at most, 0 = every frame
+    };
+
+    /**
+     * One offscreen tab composited over the scene: viewport, render scale, the OSR buffer CEF paints into and its compositor
+     *
+     * A layer only takes a new frame from its tab when its rate cap allows, and its compositor only uploads the tiles that changed,
+     * so a fast HUD layer never makes a static menu layer scan, copy or upload anything.
+     *
+     * Surface methods (applyPending, update, draw, blendInto, isRectOpaque, hasVisibleTiles, releaseSurface) belong to the render thread,
+     * everything else is thread safe.
+     */
+    class UiLayer
+    {
+    public:
+        UiLayer(const UiLayerConfig &config, size_t window_width, size_t window_height);
+
+        UiLayer(const UiLayer &) = delete;
+        UiLayer &operator=(const UiLayer &) = delete;
+
+        const std::string &getName() const;
+        int getZ() const;
+
+        // 0 while there is no tab
+        wui::wui_tab_id_t getTabId() const;
+
+        // The tab reported ready since it was published (see update)
+        bool isTabReady() const;
+
+        // Create the tab at the layer's current size, 0 if there already is one or it could not be created
+        // The caller registers the event listeners before handing it out with publishTab
+        wui::wui_tab_id_t createTab();
+
+        // requested_at: when the (re)start was asked for, the render thread reports the time until the tab is ready
+        void publishTab(wui::wui_tab_id_t tab_id, std::chrono::steady_clock::time_point requested_at, bool from_spare);
+
+        // Forget the tab and hand it back for closing, 0 if there was none
+        wui::wui_tab_id_t releaseTab();
+
+        // Spare tab (see render::setDefaultUiPrewarm): loads the page in the background while the layer runs or is closed,
+        // so the next restart takes it over instead of waiting for CEF to load and parse the page
+        // 0 if there already is one or it could not be created
+        wui::wui_tab_id_t createSpareTab();
+
+        // The spare becomes the layer's tab (its OSR buffer included), 0 if there is no spare or the layer still has a tab
+        // The caller registers the event listeners before handing it out with publishTab
+        wui::wui_tab_id_t takeSpareTab();
+
+        // Forget the spare and hand it back for closing, 0 if there was none
+        wui::wui_tab_id_t releaseSpareTab();
+
+        // Applied by the render thread on its next frame
+        void setScale(float scale);
+        float getScale() const;
+        void setViewport(const recti &viewport);
+
+        // Resolved against the window, window pixels
+        recti getViewport() const;
+
+        // Render thread: resolve pending scale / viewport changes (all of it if the window changed), resize compositor and tab
+        void applyPending(size_t window_width, size_t window_height, bool window_changed);
+
+        // Render thread: take the tab's frame unless the rate cap says not yet. Returns false if the tab was busy (painting, resizing)
+        // Also reports the (re)start latency once a freshly published tab is ready
+        bool update(std::chrono::steady_clock::time_point now);
+
+        // Render thread, onto the current target at the viewport position
+        void draw();
+
+        // Software rasterizer (job workers inside SoftRasterizer::render): blend the last frame into the area of a window sized buffer
+        void blendInto(uint8_t *dst, ptrdiff_t pitch, const recti &area) const;
+
+        // Every UI pixel over the area (window pixels) is opaque, the scene below is invisible
+        bool isRectOpaque(const rectf &window_area) const;
+        bool hasVisibleTiles() const;
+
+        // Bytes the last update scanned / uploaded, 0 if it was capped
+        size_t getCopiedBytes() const;
+        size_t getUploadedBytes() const;
+
+        // Render thread, before the display goes away
+        void releaseSurface();
+
+        // Input: position inside the viewport, and whether the last frame shows nothing there
+        bool contains(vec2i window_pos) const;
+        bool isTransparentAt(vec2i window_pos) const;
+
+        // Text input mode pushed by the page (TextInputMode), verified against WUI now and then
+        void setTextInputActive(bool active);
+        bool isTextInputActive() const;
+        void verifyTextInputMode();
+
+    private:
+        const std::string m_name;
+        const int m_z;
+        const std::chrono::nanoseconds m_frame_interval; // 0 = uncapped
+
+        std::atomic<wui::wui_tab_id_t> m_tab_id{0};
+        std::atomic<wui::wui_tab_id_t> m_spare_tab_id{0};
+
+        // OSR buffer pointer slots, one per tab (layer tab and spare). WUI keeps the slot it was handed at createOffscreenTab
+        // and rewrites it on every resize, so a slot is only ever read, never copied. takeSpareTab swaps which slot is active
+        // m_l_osr_buffer guards both against resizes, takeSpareTab and our reads
+        void *m_rgba[2] = {nullptr, nullptr};
+        size_t m_active_slot = 0; // slot of m_tab_id, the other one belongs to m_spare_tab_id
+        std::mutex m_l_osr_buffer;
+
+        // (Re)start latency, published with the tab and reported by the render thread
+        std::chrono::steady_clock::time_point m_start_requested;
+        bool m_start_from_spare = false;
+        std::atomic<bool> m_start_pending{false};
+        std::atomic<bool> m_tab_ready{false};
+
+        UiCompositor m_compositor;
+        std::chrono::steady_clock::time_point m_last_update;
+        bool m_updated = false; // last update call took a frame
+
+        // Scale and viewport as requested and as applied, both applied by the render thread under m_l_osr_buffer
+        std::atomic<float> m_scale;
+        std::atomic<float> m_scale_requested;
+        recti m_viewport_requested;
+        recti m_viewport;
+        mutable std::mutex m_l_viewport;
+        std::atomic<bool> m_surface_dirty{false};
+
+        std::atomic<bool> m_text_input_active{false};
+
+        void resolveViewport(size_t window_width, size_t window_height);
+        size_t getSurfaceWidth() const;
+        size_t getSurfaceHeight() const;
+    };
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Startup orchestration and timeline
+ * @details Init steps run as a small dependency graph, each step on its own thread as soon as its dependencies are done.
+ *
+ * Every step (and any other Phase / mark along the way) is recorded relative to process start.
+ * The timeline is logged once every renderer presented its first frame that contains UI (or ready UI tabs),
+ * or after FIRST_FRAME_TIMEOUT with whatever was recorded until then.
+ */
+namespace startup
+{
+    // Record [construction, destruction) as a named phase of the calling thread
+    class Phase
+    {
+    public:
+        explicit Phase(std::string name);
+        ~Phase();
+
+        Phase(const Phase &) = delete;
+        Phase &operator=(const Phase &) = delete;
+
+    private:
+        std::string m_name;
+        std::chrono::steady_clock::time_point m_begin;
+    };
+
+    // Zero length event
+    void mark(const std::string &name);
+
+    // Renderers that do not report a first frame by then are left out, the timeline is logged anyway
+    const std::chrono::seconds FIRST_FRAME_TIMEOUT(10);
+
+    // Number of renderers whose first UI frame ends the startup, the timeline is logged when the last one arrives
+    // Starts the FIRST_FRAME_TIMEOUT fallback, call once
+    void expectFirstFrames(size_t count);
+
+    // A renderer presented its first frame with visible UI, or (visible_ui false) the first frame after its UI tabs were ready
+    // but drew nothing visible (a transparent page or one still building its DOM)
+    void firstFrame(size_t renderer_index, bool visible_ui);
+
+    void logTimeline();
+
+    /**
+     * Init steps with dependencies
+     * Steps run detached, wait() for the ones later code relies on. Steps can not be added once started.
+     */
+    class TaskGraph
+    {
+    public:
+        typedef size_t task_t;
+
+        task_t add(std::string name, std::vector<task_t> dependencies, std::function<void()> fn);
+
+        // Start every step, returns immediately
+        void start();
+
+        // Block until the step finished
+        void wait(task_t task);
+
+    private:
+        struct Task
+        {
+            std::string name;
+            std::vector<task_t> dependencies;
+            std::function<void()> fn;
+            bool done = false;
+        };
+
+        struct State
+        {
+            std::mutex lock;
+            std::condition_variable changed;
+            std::vector<Task> tasks;
+        };
+
+        std::shared_ptr<State> m_state = std::make_shared<State>();
+        bool m_started = false;
+    };
+}
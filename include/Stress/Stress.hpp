@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include "Renderer/Renderer.hpp"
+
+/**
+ * @brief Capacity finding stress run
+ * @details Finds the highest ball count a renderer sustains at its frame rate with the UI active:
+ * doubles the count until a step misses the frame budget, then binary searches between the last step that held and the first that did not.
+ * Every step sets the count, lets the frame times settle and then measures a window of frames (Renderer::takeFrameTimings).
+ *
+ * A step holds when the chosen frame time percentile stays below the budget minus the margin and (nearly) every timer tick produced a frame.
+ * The report (JSON) lists every step and the per-phase timings at the count found.
+ *
+ * Run it against a window or a headless renderer (render::setDefaultHeadless), windows should have vsync off
+ * (render::setDefaultVsync) or every frame waits for the flip and the budget is always used up.
+ */
+namespace stress
+{
+    struct Config
+    {
+        double fps = render::BASE_FPS;
+        double margin = 0.1;      // headroom a step has to keep, fraction of the frame budget
+        double percentile = 0.95; // frame time percentile compared against the budget
+
+        size_t start_count = 256; // first step of the ramp
+        size_t max_count = 1 << 20;
+        double resolution = 0.02; // binary search stops once the bracket is this close (fraction of the count)
+
+        std::chrono::milliseconds settle{500};   // frames after changing the count that are not measured
+        std::chrono::milliseconds measure{2000}; // measured frames per step
+
+        std::string report_path = "stress_report.json";
+    };
+
+    // Blocks until the search is done and the report is written, false if the renderer never ran or the report could not be written
+    // The renderer's objects are replaced, it is left with the count found
+    bool run(render::Renderer *renderer, const Config &config);
+}
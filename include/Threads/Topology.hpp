@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Thread topology
+ * @details Names every thread the project starts and applies per role scheduling settings from a config file
+ *
+ * Config format, one role per line, '#' starts a comment, unknown keys are an error:
+ *
+ *      render   nice=-10 cpus=2,3
+ *      worker   cpus=4-7
+ *      input    policy=fifo priority=10
+ *      report   interval=10
+ *
+ * Keys: nice (-20..19), policy (other, batch, idle, fifo, rr), priority (1..99, fifo / rr only),
+ * cpus (list of cpus and ranges). The "report" line logs the CPU time of all threads every `interval` seconds.
+ *
+ * Without a config threads only get their names, scheduling stays untouched.
+ * Threads started by CEF inside wui::runTimeLoop are not ours and are not covered.
+ */
+namespace threads
+{
+    enum class Role
+    {
+        MAIN,
+        RENDER,
+        INPUT,
+        WORKER,
+        LOG,
+        LISTENER,
+        COUNT,
+    };
+
+    // Parse the config, false (and nothing applied) if the file can not be read or has errors
+    // Call before starting any subsystem, threads only pick up their settings when they register
+    bool loadConfig(const std::string &path);
+
+    // Name the calling thread, apply the settings for its role and track its CPU time
+    // name is cut to 15 characters (pthread limit)
+    void registerCurrent(Role role, const std::string &name);
+
+    // Log CPU time of every registered thread, live or finished
+    void logReport();
+
+    // Periodic report if the config asks for it
+    void startReporter();
+}
@@ -4,8 +4,12 @@
 #include "webUiInput.hpp"
 
 #include <spdlog/spdlog.h>
+#include <chrono>
 
 #include <Renderer/Renderer.hpp>
+#include "Threads/Topology.hpp"
+#include "Profiling/AllocTracker.hpp"
+#include "Profiling/Metrics.hpp"
 
 namespace input
 {
@@ -27,10 +31,23 @@ namespace input
     std::thread m_input_thread;
 
     std::atomic<proj_enums::SubSystemStates> m_state(proj_enums::SubSystemStates::STARTING);
+    std::atomic<size_t> m_event_count(0);
+
+    // Key routing uses the text input mode the page pushes, WUI is only asked this often to catch a stale cache
+    const std::chrono::milliseconds TEXT_INPUT_RECHECK(1000);
+    metrics::Counter m_events_metric("wui_input_events_total", "Hardware input events (keyboard, mouse, display) received");
+    metrics::Counter m_local_clicks_metric("wui_input_clicks_local_total", "Mouse presses over transparent UI, given to the game without asking WUI");
 
     // prototype
     void input_loop();
 
+    bool is_key_down(int keycode)
+    {
+        ALLEGRO_KEYBOARD_STATE state;
+        al_get_keyboard_state(&state);
+        return al_key_down(&state, keycode);
+    }
+
     vec2i get_mouse_position()
     {
         l_mouse_state.lock();
@@ -39,6 +56,11 @@ namespace input
         return ret;
     }
 
+    size_t getEventCount()
+    {
+        return m_event_count.load(std::memory_order_relaxed);
+    }
+
     bool wait_for_key(int keycode)
     {
 
@@ -59,6 +81,7 @@ namespace input
             return false;
         }
 
+        WUI_ALLOC_SCOPE("input.wait");
         std::vector<bool> pressed_keys = std::vector<bool>(keycodes.size(), false);
 
         auto queue = al_create_event_queue();
@@ -115,7 +138,7 @@ namespace input
         return ret;
     }
 
-    bool wait_for_mouse_button(int button, vec2i &mouse_pos)
+    bool wait_for_mouse_button(int button, vec2i &mouse_pos, ALLEGRO_DISPLAY **display)
     {
 
         if (m_state != proj_enums::SubSystemStates::RUNNING)
@@ -147,6 +170,10 @@ namespace input
                 if (event.mouse.button & button)
                 {
                     mouse_pos = {event.mouse.x, event.mouse.y};
+                    if (display != nullptr)
+                    {
+                        *display = event.mouse.display;
+                    }
                     ret = true;
                     goto wait_for_mouse_button_end;
                 }
@@ -160,21 +187,109 @@ namespace input
         return ret;
     }
 
+    bool wait_for_mouse_drag(int button, recti &area, ALLEGRO_DISPLAY **display)
+    {
+        if (m_state != proj_enums::SubSystemStates::RUNNING)
+        {
+            spdlog::error("[Input] wait_for_mouse_drag called while not running");
+            return false;
+        }
+
+        auto queue = al_create_event_queue();
+        al_register_event_source(queue, &m_manager_event_source);
+        al_register_event_source(queue, &m_abort_event_source);
+        bool ret = false;
+        bool pressed = false;
+        vec2i start;
+        while (true)
+        {
+            ALLEGRO_EVENT event;
+            al_wait_for_event(queue, &event);
+
+            if (event.type == USER_BASE_EVENT)
+            {
+                if (event.user.data1 == (int)proj_enums::SubSystemStates::SHUTTING_DOWN)
+                {
+                    ret = false;
+                    goto wait_for_mouse_drag_end;
+                }
+            }
+
+            if (event.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN && (event.mouse.button & button))
+            {
+                pressed = true;
+                start = {event.mouse.x, event.mouse.y};
+                if (display != nullptr)
+                {
+                    *display = event.mouse.display;
+                }
+            }
+
+            if (event.type == ALLEGRO_EVENT_MOUSE_BUTTON_UP && (event.mouse.button & button) && pressed)
+            {
+                area.min = {std::min(start.x, event.mouse.x), std::min(start.y, event.mouse.y)};
+                area.max = {std::max(start.x, event.mouse.x), std::max(start.y, event.mouse.y)};
+                ret = true;
+                goto wait_for_mouse_drag_end;
+            }
+        }
+
+    wait_for_mouse_drag_end:
+        al_unregister_event_source(queue, &m_manager_event_source);
+        al_destroy_event_queue(queue);
+
+        return ret;
+    }
+
     void input_loop()
     {
         // start the main receiving loop
+        threads::registerCurrent(threads::Role::INPUT, "input");
+        WUI_ALLOC_SCOPE("input.dispatch");
         m_state = proj_enums::SubSystemStates::RUNNING;
 
+        // UI layer bookkeeping, mouse input goes to the topmost layer showing something under the cursor, or to nobody
+        render::UiLayer *hovered_layer = nullptr; // layer that last got a mouse move
+        render::UiLayer *pressed_layer = nullptr; // layer the held buttons were pressed on, it gets every move and release until they are up
+        unsigned int ui_buttons_down = 0;         // buttons whose press went to WUI, their release has to follow
+        std::chrono::steady_clock::time_point next_text_input_check;
+
         while (m_state == proj_enums::SubSystemStates::RUNNING)
         {
             ALLEGRO_EVENT event;
 
             // Fetch the event (if one exists)
             al_wait_for_event(m_hardware_event_sources_queue, &event);
+            m_event_count.fetch_add(1, std::memory_order_relaxed);
+            m_events_metric.inc();
 
             // Handle the event
             bool wasUiEvent = false;
 
+            // Route to the renderer whose window the event belongs to
+            // keyboard events carry the focused display, fall back to the last focused renderer
+            render::Renderer *target = nullptr;
+            switch (event.type)
+            {
+            case ALLEGRO_EVENT_MOUSE_AXES:
+            case ALLEGRO_EVENT_MOUSE_BUTTON_DOWN:
+            case ALLEGRO_EVENT_MOUSE_BUTTON_UP:
+                target = render::getRenderer(event.mouse.display);
+                break;
+            case ALLEGRO_EVENT_KEY_CHAR:
+            case ALLEGRO_EVENT_KEY_UP:
+            case ALLEGRO_EVENT_KEY_DOWN:
+                target = render::getRenderer(event.keyboard.display);
+                break;
+            default:
+                break;
+            }
+
+            if (target == nullptr)
+            {
+                target = render::getFocusedRenderer();
+            }
+
             // When the "buttonDown" event fires over UI element, and it hit the UI
             // We also need to _always_ send the buttonUp event, even if it did not hit the UI -> using the force flag
             // This also allows up to detect "dragging"
@@ -190,25 +305,69 @@ namespace input
                 m_mouse_state.y = event.mouse.y;
                 l_mouse_state.unlock();
 
-                const wui::wui_mouse_event_t ev = convertMouseEvent(event);
-
                 if (wuiButtonDown)
                 {
                     wuiDragging = true;
                     // TODO: wui start dragging
                 }
 
-                wui::sendMouseMoveEvent(render::renderer.wui_tab_id, ev, false);
+                render::UiLayer *layer = nullptr;
+                if (ui_buttons_down != 0)
+                {
+                    layer = pressed_layer;
+                }
+                else if (target != nullptr)
+                {
+                    layer = target->getUiLayerAt(vec2i(event.mouse.x, event.mouse.y));
+                }
+
+                if (hovered_layer != nullptr && hovered_layer != layer)
+                {
+                    // left this layer, one last move so hover states end, then nothing until it comes back
+                    const wui::wui_mouse_event_t ev = convertMouseEvent(event, hovered_layer->getViewport().min, hovered_layer->getScale());
+                    wui::sendMouseMoveEvent(hovered_layer->getTabId(), ev, true);
+                }
+
+                if (layer != nullptr)
+                {
+                    const wui::wui_mouse_event_t ev = convertMouseEvent(event, layer->getViewport().min, layer->getScale());
+                    wui::sendMouseMoveEvent(layer->getTabId(), ev, false);
+                }
+                hovered_layer = layer;
             }
 
             break;
 
             case ALLEGRO_EVENT_MOUSE_BUTTON_DOWN:
             {
-                spdlog::info("[Input] mouse button down {}, @ {} {}", event.mouse.button == 1 ? "left" : "right", event.mouse.x, event.mouse.y);
+                SPDLOG_DEBUG("[Input] mouse button down {}, @ {} {}", event.mouse.button == 1 ? "left" : "right", event.mouse.x, event.mouse.y);
+
+                if (target == nullptr)
+                {
+                    break;
+                }
 
-                const wui::wui_mouse_event_t ev = convertMouseEvent(event);
-                wasUiEvent = wui::sendMouseClickEvent(render::renderer.wui_tab_id, ev, event.mouse.button == 1 ? wui::MBT_LEFT : wui::MBT_RIGHT, false) == wui::WUI_HIT_UI;
+                const vec2i pos(event.mouse.x, event.mouse.y);
+                render::UiLayer *layer = ui_buttons_down != 0 ? pressed_layer : target->getUiLayerAt(pos);
+
+                if (layer == nullptr)
+                {
+                    // no layer shows anything under the cursor, no need to ask WUI whose click it is
+                    // while a text field has focus the click still goes to its layer, so the page sees it lose focus
+                    render::UiLayer *focused = target->getFocusedUiLayer();
+                    if (focused == nullptr || !focused->isTextInputActive() || !focused->contains(pos))
+                    {
+                        m_local_clicks_metric.inc();
+                        break;
+                    }
+                    layer = focused;
+                }
+
+                const wui::wui_mouse_event_t ev = convertMouseEvent(event, layer->getViewport().min, layer->getScale());
+                wasUiEvent = wui::sendMouseClickEvent(layer->getTabId(), ev, event.mouse.button == 1 ? wui::MBT_LEFT : wui::MBT_RIGHT, false) == wui::WUI_HIT_UI;
+                ui_buttons_down |= 1u << event.mouse.button;
+                pressed_layer = layer;
+                target->focusUiLayer(layer);
 
                 if (wasUiEvent)
                 {
@@ -219,11 +378,18 @@ namespace input
             }
             case ALLEGRO_EVENT_MOUSE_BUTTON_UP:
             {
-                spdlog::info("[Input] mouse button up {}, @ {} {}", event.mouse.button == 1 ? "left" : "right", event.mouse.x, event.mouse.y);
+                SPDLOG_DEBUG("[Input] mouse button up {}, @ {} {}", event.mouse.button == 1 ? "left" : "right", event.mouse.x, event.mouse.y);
+
+                // a press on a layer is always released in that layer, wherever the mouse went meanwhile
+                if (!(ui_buttons_down & (1u << event.mouse.button)) || pressed_layer == nullptr)
+                {
+                    break;
+                }
+                ui_buttons_down &= ~(1u << event.mouse.button);
 
-                const wui::wui_mouse_event_t ev = convertMouseEvent(event);
+                const wui::wui_mouse_event_t ev = convertMouseEvent(event, pressed_layer->getViewport().min, pressed_layer->getScale());
 
-                wasUiEvent = wui::sendMouseClickEvent(render::renderer.wui_tab_id, ev, event.mouse.button == 1 ? wui::MBT_LEFT : wui::MBT_RIGHT, true, true) == wui::WUI_HIT_UI;
+                wasUiEvent = wui::sendMouseClickEvent(pressed_layer->getTabId(), ev, event.mouse.button == 1 ? wui::MBT_LEFT : wui::MBT_RIGHT, true, true) == wui::WUI_HIT_UI;
 
                 if (wasUiEvent)
                 {
@@ -249,10 +415,21 @@ namespace input
             case ALLEGRO_EVENT_KEY_UP:
             case ALLEGRO_EVENT_KEY_DOWN:
             {
-                wui::wui_text_input_mode_t ret = wui::WUI_TEXT_INPUT_MODE_ERROR;
-                WUI_ERROR_CHECK(wui::getCurrentTextInputMode(render::renderer.wui_tab_id, ret));
+                // keys go to the layer clicked last
+                render::UiLayer *layer = target != nullptr ? target->getFocusedUiLayer() : nullptr;
+                if (layer == nullptr)
+                {
+                    break;
+                }
+
+                const auto now = std::chrono::steady_clock::now();
+                if (now >= next_text_input_check)
+                {
+                    layer->verifyTextInputMode();
+                    next_text_input_check = now + TEXT_INPUT_RECHECK;
+                }
 
-                if (ret != wui::WUI_TEXT_INPUT_MODE_NONE)
+                if (layer->isTextInputActive())
                 {
 
                     if (event.keyboard.repeat)
@@ -260,7 +437,7 @@ namespace input
                         break;
                     }
 
-                    handleKeyEvent(render::renderer.wui_tab_id, event);
+                    handleKeyEvent(layer->getTabId(), event);
                     wasUiEvent = true;
                 }
             }
@@ -4,12 +4,12 @@
 #include "spdlog/spdlog.h"
 namespace input
 {
-    wui::wui_mouse_event_t convertMouseEvent(ALLEGRO_EVENT &event)
+    wui::wui_mouse_event_t convertMouseEvent(ALLEGRO_EVENT &event, vec2i ui_origin, float ui_scale)
     {
 
         return (wui::wui_mouse_event_t){
-            .x = event.mouse.x,
-            .y = event.mouse.y,
+            .x = (int)((event.mouse.x - ui_origin.x) * ui_scale),
+            .y = (int)((event.mouse.y - ui_origin.y) * ui_scale),
         };
     }
 
@@ -60,7 +60,7 @@ namespace input
         // careful when using allegro!
         // allegro handles the different events in a mixed fashion
 
-        auto eventString = [](ALLEGRO_EVENT_TYPE type)
+        [[maybe_unused]] auto eventString = [](ALLEGRO_EVENT_TYPE type)
         {
             switch (type)
             {
@@ -81,7 +81,7 @@ namespace input
             return wui::WUI_OK;
         }
 
-        spdlog::info("[Input] {} convert Key event: type: {} unichar: {:8d} 0x{:2X} modifiers: 0x{:2X} keycode: {} ({})",
+        SPDLOG_DEBUG("[Input] {} convert Key event: type: {} unichar: {:8d} 0x{:2X} modifiers: 0x{:2X} keycode: {} ({})",
                      eventString(event.keyboard.type),
                      event.keyboard.type,
                      event.keyboard.unichar,
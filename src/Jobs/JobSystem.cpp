@@ -0,0 +1,290 @@
+#include "Jobs/JobSystem.hpp"
+#include "Threads/Topology.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace jobs
+{
+    // Maximum number of pending chunks per worker, overflow is run inline by the submitter
+    const size_t QUEUE_CAPACITY = 1024;
+
+    // Budget per chunk, about half of a typical L2 so the next chunk can be prefetched
+    const size_t CHUNK_CACHE_BYTES = 128 * 1024;
+
+    struct JobGroup
+    {
+        detail::job_fn_t fn;
+        void *ctx;
+        std::atomic<size_t> pending;
+    };
+
+    struct Job
+    {
+        JobGroup *group;
+        size_t begin;
+        size_t end;
+    };
+
+    // Fixed size ring, the owning worker takes from the front, thieves take from the back
+    // so they grab the chunks farthest away from what the owner is working on
+    struct alignas(64) WorkQueue
+    {
+        std::mutex lock;
+        Job jobs[QUEUE_CAPACITY];
+        size_t head = 0;
+        size_t count = 0;
+
+        bool push(const Job &job)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (count == QUEUE_CAPACITY)
+            {
+                return false;
+            }
+            jobs[(head + count) % QUEUE_CAPACITY] = job;
+            count++;
+            return true;
+        }
+
+        bool popFront(Job &job)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (count == 0)
+            {
+                return false;
+            }
+            job = jobs[head];
+            head = (head + 1) % QUEUE_CAPACITY;
+            count--;
+            return true;
+        }
+
+        bool popBack(Job &job)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (count == 0)
+            {
+                return false;
+            }
+            count--;
+            job = jobs[(head + count) % QUEUE_CAPACITY];
+            return true;
+        }
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    std::atomic<bool> m_running(false);
+    std::atomic<bool> m_deterministic(false);
+
+    // Chunks sitting in any queue, workers sleep while this is 0
+    std::atomic<size_t> m_queued(0);
+    std::mutex l_sleep;
+    std::condition_variable m_wakeup;
+
+    // Index of the worker running on this thread, SIZE_MAX for non workers
+    thread_local size_t t_worker_index = SIZE_MAX;
+
+    void execute(const Job &job)
+    {
+        job.group->fn(job.group->ctx, job.begin, job.end);
+        job.group->pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    // Own queue first (front), then steal from the others (back)
+    bool take(size_t self, Job &job)
+    {
+        const size_t queue_count = m_queues.size();
+
+        if (self < queue_count && m_queues[self]->popFront(job))
+        {
+            m_queued--;
+            return true;
+        }
+
+        const size_t first = self < queue_count ? self + 1 : 0;
+        for (size_t i = 0; i < queue_count; i++)
+        {
+            auto &victim = m_queues[(first + i) % queue_count];
+            if (victim->popBack(job))
+            {
+                m_queued--;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void worker_loop(size_t index)
+    {
+        t_worker_index = index;
+        threads::registerCurrent(threads::Role::WORKER, fmt::format("worker-{}", index));
+
+        while (true)
+        {
+            Job job;
+            if (take(index, job))
+            {
+                execute(job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lk(l_sleep);
+            m_wakeup.wait(lk, []()
+                          { return m_queued > 0 || !m_running; });
+
+            if (!m_running && m_queued == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    void start(size_t worker_count)
+    {
+        if (m_running)
+        {
+            spdlog::warn("[Jobs] already running");
+            return;
+        }
+
+        if (worker_count == 0)
+        {
+            const size_t hw = std::thread::hardware_concurrency();
+            worker_count = hw > 1 ? hw - 1 : 1;
+        }
+
+        m_running = true;
+
+        for (size_t i = 0; i < worker_count; i++)
+        {
+            m_queues.push_back(std::make_unique<WorkQueue>());
+        }
+
+        for (size_t i = 0; i < worker_count; i++)
+        {
+            m_workers.emplace_back(worker_loop, i);
+        }
+
+        spdlog::info("[Jobs] started {} workers ({})", worker_count, m_deterministic ? "deterministic" : "non-deterministic");
+    }
+
+    void shutdown()
+    {
+        if (!m_running)
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(l_sleep);
+            m_running = false;
+        }
+        m_wakeup.notify_all();
+
+        for (auto &worker : m_workers)
+        {
+            worker.join();
+        }
+
+        m_workers.clear();
+        m_queues.clear();
+
+        spdlog::info("[Jobs] shutdown complete");
+    }
+
+    size_t getWorkerCount()
+    {
+        return m_workers.size();
+    }
+
+    void setDeterministic(bool deterministic)
+    {
+        m_deterministic = deterministic;
+    }
+
+    bool isDeterministic()
+    {
+        return m_deterministic;
+    }
+
+    size_t cacheChunk(size_t bytes_per_item)
+    {
+        return std::max<size_t>(1, CHUNK_CACHE_BYTES / std::max<size_t>(1, bytes_per_item));
+    }
+
+    namespace detail
+    {
+        void run(size_t begin, size_t end, size_t chunk, job_fn_t fn, void *ctx)
+        {
+            if (end <= begin)
+            {
+                return;
+            }
+
+            chunk = chunk == 0 ? 1 : chunk;
+
+            const size_t chunk_count = (end - begin + chunk - 1) / chunk;
+            const size_t queue_count = m_queues.size();
+
+            // Not worth (or not possible) to distribute, keep the chunk boundaries though
+            if (!m_running || queue_count == 0 || chunk_count == 1)
+            {
+                for (size_t b = begin; b < end; b += chunk)
+                {
+                    fn(ctx, b, std::min(end, b + chunk));
+                }
+                return;
+            }
+
+            JobGroup group;
+            group.fn = fn;
+            group.ctx = ctx;
+            group.pending = chunk_count;
+
+            // Counted up front so a worker popping a chunk early never sees the counter underflow
+            m_queued += chunk_count;
+
+            // Contiguous runs of chunks per worker, neighbouring objects stay on the same core
+            for (size_t i = 0; i < chunk_count; i++)
+            {
+                const size_t b = begin + i * chunk;
+                const Job job = {&group, b, std::min(end, b + chunk)};
+
+                if (!m_queues[i * queue_count / chunk_count]->push(job))
+                {
+                    m_queued--;
+                    execute(job);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(l_sleep);
+            }
+            m_wakeup.notify_all();
+
+            // Help out instead of blocking, the caller counts as an additional worker
+            while (group.pending.load(std::memory_order_acquire) > 0)
+            {
+                Job job;
+                if (take(t_worker_index, job))
+                {
+                    execute(job);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,277 @@
+#include "Logging/Logging.hpp"
+#include "Threads/Topology.hpp"
+
+#include <spdlog/sinks/sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace logging
+{
+    // Longer messages are truncated, keeps every slot fixed size so enqueueing never allocates
+    const size_t MAX_PAYLOAD = 480;
+
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        spdlog::level::level_enum level;
+        spdlog::log_clock::time_point time;
+        size_t thread_id;
+        size_t length;
+        char payload[MAX_PAYLOAD];
+    };
+
+    /**
+     * Bounded multi producer ring (D. Vyukov's sequence number scheme)
+     * Producers claim a slot with one CAS on the tail, the slot sequence tells the consumer when it is filled.
+     */
+    class LogRing
+    {
+    public:
+        explicit LogRing(size_t capacity) : m_mask(capacity - 1), m_slots(new Slot[capacity])
+        {
+            for (size_t i = 0; i < capacity; i++)
+            {
+                m_slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        bool push(const spdlog::details::log_msg &msg)
+        {
+            size_t pos = m_tail.load(std::memory_order_relaxed);
+            Slot *slot;
+
+            while (true)
+            {
+                slot = &m_slots[pos & m_mask];
+                const size_t seq = slot->sequence.load(std::memory_order_acquire);
+                const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+                if (diff == 0)
+                {
+                    if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false; // full
+                }
+                else
+                {
+                    pos = m_tail.load(std::memory_order_relaxed);
+                }
+            }
+
+            slot->level = msg.level;
+            slot->time = msg.time;
+            slot->thread_id = msg.thread_id;
+            slot->length = std::min(msg.payload.size(), MAX_PAYLOAD);
+            memcpy(slot->payload, msg.payload.data(), slot->length);
+
+            slot->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // single consumer
+        Slot *front()
+        {
+            Slot *slot = &m_slots[m_head & m_mask];
+            return slot->sequence.load(std::memory_order_acquire) == m_head + 1 ? slot : nullptr;
+        }
+
+        void pop(Slot *slot)
+        {
+            slot->sequence.store(m_head + m_mask + 1, std::memory_order_release);
+            m_head++;
+        }
+
+    private:
+        const size_t m_mask;
+        std::unique_ptr<Slot[]> m_slots;
+        alignas(64) std::atomic<size_t> m_tail = ATOMIC_VAR_INIT(0);
+        alignas(64) size_t m_head = 0;
+    };
+
+    // The only sink of the async default logger, producer side of the ring
+    class RingSink : public spdlog::sinks::sink
+    {
+    public:
+        RingSink(LogRing &ring, std::vector<spdlog::sink_ptr> targets) : m_ring(ring), m_targets(std::move(targets)) {}
+
+        void log(const spdlog::details::log_msg &msg) override
+        {
+            if (!m_ring.push(msg))
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void flush() override {}
+
+        void set_pattern(const std::string &pattern) override
+        {
+            for (auto &target : m_targets)
+            {
+                target->set_pattern(pattern);
+            }
+        }
+
+        void set_formatter(std::unique_ptr<spdlog::formatter> sink_formatter) override
+        {
+            for (auto &target : m_targets)
+            {
+                target->set_formatter(sink_formatter->clone());
+            }
+        }
+
+        std::atomic<size_t> m_dropped = ATOMIC_VAR_INIT(0);
+
+    private:
+        LogRing &m_ring;
+        std::vector<spdlog::sink_ptr> m_targets;
+    };
+
+    std::mutex l_logging;
+    std::unique_ptr<LogRing> m_ring;
+    std::shared_ptr<RingSink> m_ring_sink;
+    // kept alive forever, spdlog::info() and friends use the raw default logger pointer without a reference
+    std::shared_ptr<spdlog::logger> m_async_logger;
+    std::vector<spdlog::sink_ptr> m_targets;
+    std::thread m_backend_thread;
+    std::atomic<bool> m_running(false);
+    size_t m_reported_dropped = 0;
+
+    void backend_loop()
+    {
+        threads::registerCurrent(threads::Role::LOG, "log");
+
+        size_t idle_rounds = 0;
+        std::string logger_name;
+
+        while (true)
+        {
+            Slot *slot = m_ring->front();
+
+            if (slot == nullptr)
+            {
+                if (!m_running)
+                {
+                    break; // producers are gone and the ring is drained
+                }
+
+                for (auto &target : m_targets)
+                {
+                    target->flush();
+                }
+
+                // nothing queued, back off a little further each time (max 2ms latency on the output)
+                idle_rounds = std::min<size_t>(idle_rounds + 1, 20);
+                std::this_thread::sleep_for(std::chrono::microseconds(100 * idle_rounds));
+                continue;
+            }
+
+            idle_rounds = 0;
+
+            spdlog::details::log_msg msg(slot->time, spdlog::source_loc{}, logger_name, slot->level, spdlog::string_view_t(slot->payload, slot->length));
+            msg.thread_id = slot->thread_id;
+
+            for (auto &target : m_targets)
+            {
+                if (target->should_log(msg.level))
+                {
+                    target->log(msg);
+                }
+            }
+
+            m_ring->pop(slot);
+
+            const size_t dropped = m_ring_sink->m_dropped.load(std::memory_order_relaxed);
+            if (dropped != m_reported_dropped && m_ring->front() == nullptr)
+            {
+                const std::string text = fmt::format("[Logging] queue full, {} messages dropped so far", dropped);
+                spdlog::details::log_msg warning(spdlog::source_loc{}, logger_name, spdlog::level::warn, text);
+                for (auto &target : m_targets)
+                {
+                    target->log(warning);
+                }
+                m_reported_dropped = dropped;
+            }
+        }
+
+        for (auto &target : m_targets)
+        {
+            target->flush();
+        }
+    }
+
+    void startAsync(size_t queue_size)
+    {
+        std::lock_guard<std::mutex> guard(l_logging);
+
+        // the async logger stays installed in spdlog's raw pointer, so the ring can only be set up once
+        if (m_running || m_ring)
+        {
+            return;
+        }
+
+        size_t capacity = 2;
+        while (capacity < queue_size)
+        {
+            capacity <<= 1;
+        }
+
+        auto level = spdlog::default_logger()->level();
+
+        m_targets = {std::make_shared<spdlog::sinks::stdout_color_sink_mt>()};
+        m_ring = std::make_unique<LogRing>(capacity);
+        m_ring_sink = std::make_shared<RingSink>(*m_ring, m_targets);
+
+        m_running = true;
+        m_backend_thread = std::thread(backend_loop);
+
+        m_async_logger = std::make_shared<spdlog::logger>("", m_ring_sink);
+        m_async_logger->set_level(level);
+        spdlog::set_default_logger(m_async_logger);
+
+        // detached listener threads exit() the process, make sure the tail of the log still gets out
+        static bool registered = false;
+        if (!registered)
+        {
+            registered = true;
+            std::atexit(shutdown);
+        }
+
+        spdlog::info("[Logging] async logging with a {} entry queue", capacity);
+    }
+
+    void shutdown()
+    {
+        std::lock_guard<std::mutex> guard(l_logging);
+
+        if (!m_running)
+        {
+            return;
+        }
+
+        // new messages go straight to the console again, then let the backend drain what is left
+        auto level = spdlog::default_logger()->level();
+        auto logger = std::make_shared<spdlog::logger>("", m_targets.begin(), m_targets.end());
+        logger->set_level(level);
+        spdlog::set_default_logger(logger);
+
+        m_running = false;
+        m_backend_thread.join();
+    }
+
+    size_t getDroppedCount()
+    {
+        return m_ring_sink ? m_ring_sink->m_dropped.load() : 0;
+    }
+}
@@ -1,9 +1,12 @@
 #include "Objects/Ball.hpp"
+#include "Renderer/SoftRaster.hpp"
 
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_primitives.h>
 #include <spdlog/spdlog.h>
 
+#include "webUiBinding.hpp"
+
 #include <cmath>
 
 namespace objects
@@ -11,51 +14,104 @@ namespace objects
 
     Ball::Ball(int x, int y)
     {
-        m_x = x;
-        m_y = y;
+        m_position = {(float)x, (float)y};
         m_radius = 10 + rand() % 100;
-        m_speed = 200 + rand() % 200;
-        m_angle = 20 + rand() % 20;
+        const float speed = 200 + rand() % 200;
+        const float angle = 20 + rand() % 20;
         m_color = al_map_rgb(rand() % 255, rand() % 255, rand() % 255);
 
-        spdlog::info("Ball created at ({}, {}) with radius {}, speed {} and angle {}", m_x, m_y, m_radius, m_speed, m_angle);
+        // direction is fixed between bounces, resolve it once instead of every frame
+        m_velocity = vec2f(std::cos(angle), std::sin(angle)) * speed;
+
+        SPDLOG_DEBUG("Ball created at ({}, {}) with radius {}, speed {} and angle {}", m_position.x, m_position.y, m_radius, speed, angle);
+    }
+
+    Ball::Ball(const BallRecord &record) : Renderable(record.id)
+    {
+        m_position = {record.x, record.y};
+        m_velocity = {record.vx, record.vy};
+        m_radius = record.radius;
+        m_color = {record.r, record.g, record.b, record.a};
     }
 
-    void Ball::render(const size_t displayWidth, const size_t displayHeight, const double delta_t)
+    void Ball::update(const size_t displayWidth, const size_t displayHeight, const double delta_t)
     {
-        // change position based on speed and angle
-        m_x += m_speed * delta_t * cos(m_angle);
-        m_y += m_speed * delta_t * sin(m_angle);
+        // change position based on velocity
+        m_position += m_velocity * delta_t;
 
-        // bounce off walls
-        if (m_x < 0)
+        // bounce off walls, mirroring the angle is the same as flipping one velocity component
+        if (m_position.x < 0)
         {
-            m_x = 0;
-            m_angle = M_PI - m_angle;
+            m_position.x = 0;
+            m_velocity.x = -m_velocity.x;
         }
-        else if (m_x > displayWidth)
+        else if (m_position.x > displayWidth)
         {
-            m_x = displayWidth;
-            m_angle = M_PI - m_angle;
+            m_position.x = displayWidth;
+            m_velocity.x = -m_velocity.x;
         }
 
-        if (m_y < 0)
+        if (m_position.y < 0)
         {
-            m_y = 0;
-            m_angle = -m_angle;
+            m_position.y = 0;
+            m_velocity.y = -m_velocity.y;
         }
-        else if (m_y > displayHeight)
+        else if (m_position.y > displayHeight)
         {
-            m_y = displayHeight;
-            m_angle = -m_angle;
+            m_position.y = displayHeight;
+            m_velocity.y = -m_velocity.y;
         }
+    }
+
+    void Ball::draw()
+    {
+        al_draw_filled_circle(m_position.x, m_position.y, m_radius, m_color);
+    }
+
+    void Ball::rasterize(render::SoftRasterizer &raster) const
+    {
+        raster.addCircle(m_position, m_radius, m_color);
+    }
+
+    rectf Ball::getBounds() const
+    {
+        return rectf::around(m_position, m_radius);
+    }
 
-        // draw
-        al_draw_filled_circle(m_x, m_y, m_radius, m_color);
+    bool Ball::hitTest(vec2f point) const
+    {
+        return (point - m_position).mag2() <= m_radius * m_radius;
+    }
+
+    void Ball::serialize(cJSON *out) const
+    {
+        cJSON_AddNumberToObject(out, "x", m_position.x);
+        cJSON_AddNumberToObject(out, "y", m_position.y);
+
+        unsigned char hex[3];
+        al_unmap_rgb(m_color, &hex[0], &hex[1], &hex[2]);
+
+        const std::string hexString = fmt::format("#{:02x}{:02x}{:02x}", hex[0], hex[1], hex[2]);
+        cJSON_AddStringToObject(out, "colorHex", hexString.c_str());
+    }
+
+    float Ball::getRadius() const
+    {
+        return m_radius;
+    }
+
+    double Ball::getKineticEnergy() const
+    {
+        return 0.5 * m_radius * m_radius * m_velocity.mag2();
     }
 
     ALLEGRO_COLOR Ball::getColor() const
     {
         return m_color;
     }
+
+    BallRecord Ball::toRecord() const
+    {
+        return {getId(), m_position.x, m_position.y, m_velocity.x, m_velocity.y, m_radius, m_color.r, m_color.g, m_color.b, m_color.a};
+    }
 }
\ No newline at end of file
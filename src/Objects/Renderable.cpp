@@ -3,22 +3,32 @@
 namespace objects
 
 {
-    int Renderable::generator_id = 0;
+    std::atomic<int> Renderable::generator_id(0);
 
     Renderable::Renderable()
     {
-        m_x = 0;
-        m_y = 0;
+        m_position = {0, 0};
         m_id = generator_id++;
     }
 
-    Position Renderable::getPosition()
+    Renderable::Renderable(int id)
     {
-        return {
-            m_x,
-            m_y};
+        m_position = {0, 0};
+        m_id = id;
+
+        int next = generator_id;
+        while (next <= id && !generator_id.compare_exchange_weak(next, id + 1))
+        {
+        }
+    }
+
+    Position Renderable::getPosition() const
+    {
+        return m_position;
     }
 
     int Renderable::getId() const { return m_id; }
 
+    Handle Renderable::getHandle() const { return m_handle; }
+
 }
\ No newline at end of file
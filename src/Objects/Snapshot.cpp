@@ -0,0 +1,153 @@
+#include "Objects/Snapshot.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace objects
+{
+    bool writeSnapshot(const std::string &path, const BallRecord *records, size_t count, uint32_t scene_width, uint32_t scene_height)
+    {
+        SnapshotHeader header = {};
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.header_size = sizeof(SnapshotHeader);
+        header.record_size = sizeof(BallRecord);
+        header.scene_width = scene_width;
+        header.scene_height = scene_height;
+        header.count = count;
+
+        // write next to the target and rename, a crash never leaves a half written snapshot behind
+        const std::string tmp_path = path + ".tmp";
+        FILE *file = fopen(tmp_path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            spdlog::error("[Snapshot] could not create {}: {}", tmp_path, strerror(errno));
+            return false;
+        }
+
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = ok && (count == 0 || fwrite(records, sizeof(BallRecord), count, file) == count);
+        ok = (fclose(file) == 0) && ok;
+        ok = ok && rename(tmp_path.c_str(), path.c_str()) == 0;
+
+        if (!ok)
+        {
+            spdlog::error("[Snapshot] could not write {}: {}", path, strerror(errno));
+            remove(tmp_path.c_str());
+        }
+        return ok;
+    }
+
+    SnapshotFile::~SnapshotFile()
+    {
+        close();
+    }
+
+    bool SnapshotFile::open(const std::string &path)
+    {
+        close();
+
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            spdlog::error("[Snapshot] could not open {}: {}", path, strerror(errno));
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SnapshotHeader))
+        {
+            spdlog::error("[Snapshot] {} is not a snapshot (too small)", path);
+            ::close(fd);
+            return false;
+        }
+
+        void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+
+        if (data == MAP_FAILED)
+        {
+            spdlog::error("[Snapshot] could not map {}: {}", path, strerror(errno));
+            return false;
+        }
+
+        m_data = static_cast<const uint8_t *>(data);
+        m_size = info.st_size;
+
+        const SnapshotHeader &header = getHeader();
+        if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0)
+        {
+            spdlog::error("[Snapshot] {} is not a snapshot (bad magic)", path);
+            close();
+            return false;
+        }
+
+        // newer versions only append, anything at least as large as what we know is readable
+        if (header.version < 1 || header.header_size < sizeof(SnapshotHeader) || header.header_size > m_size || header.record_size < sizeof(BallRecord))
+        {
+            spdlog::error("[Snapshot] {} has unsupported version {} (header size {}, record size {})", path, header.version, header.header_size,
+                          header.record_size);
+            close();
+            return false;
+        }
+
+        // records are handed out in place, the mapping is page aligned so both sizes have to keep them aligned
+        if (header.header_size % alignof(BallRecord) != 0 || header.record_size % alignof(BallRecord) != 0)
+        {
+            spdlog::error("[Snapshot] {} has misaligned records (header size {}, record size {})", path, header.header_size, header.record_size);
+            close();
+            return false;
+        }
+
+        if (header.version > SNAPSHOT_VERSION)
+        {
+            spdlog::info("[Snapshot] {} is version {}, reading the version {} fields", path, header.version, SNAPSHOT_VERSION);
+        }
+
+        if ((m_size - header.header_size) / header.record_size < header.count)
+        {
+            spdlog::error("[Snapshot] {} is truncated, header says {} records", path, header.count);
+            close();
+            return false;
+        }
+
+        // read front to back exactly once
+        madvise(data, m_size, MADV_SEQUENTIAL);
+        madvise(data, m_size, MADV_WILLNEED);
+        return true;
+    }
+
+    void SnapshotFile::close()
+    {
+        if (m_data != nullptr)
+        {
+            munmap((void *)m_data, m_size);
+            m_data = nullptr;
+            m_size = 0;
+        }
+    }
+
+    const SnapshotHeader &SnapshotFile::getHeader() const
+    {
+        return *reinterpret_cast<const SnapshotHeader *>(m_data);
+    }
+
+    size_t SnapshotFile::getCount() const
+    {
+        return m_data != nullptr ? getHeader().count : 0;
+    }
+
+    const BallRecord &SnapshotFile::getRecord(size_t index) const
+    {
+        const SnapshotHeader &header = getHeader();
+        return *reinterpret_cast<const BallRecord *>(m_data + header.header_size + index * header.record_size);
+    }
+}
@@ -0,0 +1,297 @@
+#include "Objects/SpatialGrid.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+namespace objects
+{
+    namespace
+    {
+        inline vec2f center(const rectf &r)
+        {
+            return (r.min + r.max) * 0.5f;
+        }
+    }
+
+    SpatialGrid::SpatialGrid(float cell_size, uint32_t type_count) : m_type_count(type_count), m_cell_size(cell_size), m_inv_cell_size(1.0f / cell_size)
+    {
+        assert(cell_size > 0 && "cell size must be positive");
+        m_cells.assign(1, UINT32_MAX);
+    }
+
+    void SpatialGrid::resize(float width, float height)
+    {
+        m_cols = std::max(1, (int)std::ceil(width * m_inv_cell_size));
+        m_rows = std::max(1, (int)std::ceil(height * m_inv_cell_size));
+
+        m_cells.assign((size_t)m_cols * m_rows, UINT32_MAX);
+
+        for (uint32_t slot = 0; slot < m_entries.size(); slot++)
+        {
+            if (m_entries[slot].cell != UINT32_MAX)
+            {
+                link(slot, cellOf(center(m_entries[slot].bounds)));
+            }
+        }
+    }
+
+    void SpatialGrid::reserve(size_t count)
+    {
+        const size_t entries = count * m_type_count;
+        if (entries > m_entries.size())
+        {
+            m_entries.resize(entries);
+        }
+    }
+
+    uint32_t SpatialGrid::entryOf(Handle handle) const
+    {
+        return handle.index * m_type_count + handle.type;
+    }
+
+    uint32_t SpatialGrid::cellOf(vec2f point) const
+    {
+        const int x = std::clamp((int)std::floor(point.x * m_inv_cell_size), 0, m_cols - 1);
+        const int y = std::clamp((int)std::floor(point.y * m_inv_cell_size), 0, m_rows - 1);
+        return (uint32_t)(y * m_cols + x);
+    }
+
+    void SpatialGrid::cellRange(const rectf &area, int &x0, int &y0, int &x1, int &y1) const
+    {
+        // an object filed in a cell may reach m_max_extent beyond it
+        x0 = std::clamp((int)std::floor((area.min.x - m_max_extent) * m_inv_cell_size), 0, m_cols - 1);
+        y0 = std::clamp((int)std::floor((area.min.y - m_max_extent) * m_inv_cell_size), 0, m_rows - 1);
+        x1 = std::clamp((int)std::floor((area.max.x + m_max_extent) * m_inv_cell_size), 0, m_cols - 1);
+        y1 = std::clamp((int)std::floor((area.max.y + m_max_extent) * m_inv_cell_size), 0, m_rows - 1);
+    }
+
+    void SpatialGrid::link(uint32_t slot, uint32_t cell)
+    {
+        Entry &entry = m_entries[slot];
+        entry.cell = cell;
+        entry.prev = UINT32_MAX;
+        entry.next = m_cells[cell];
+        if (entry.next != UINT32_MAX)
+        {
+            m_entries[entry.next].prev = slot;
+        }
+        m_cells[cell] = slot;
+    }
+
+    void SpatialGrid::unlink(uint32_t slot)
+    {
+        Entry &entry = m_entries[slot];
+
+        if (entry.prev != UINT32_MAX)
+        {
+            m_entries[entry.prev].next = entry.next;
+        }
+        else
+        {
+            m_cells[entry.cell] = entry.next;
+        }
+        if (entry.next != UINT32_MAX)
+        {
+            m_entries[entry.next].prev = entry.prev;
+        }
+
+        entry.cell = UINT32_MAX;
+    }
+
+    void SpatialGrid::update(Handle handle, const rectf &bounds)
+    {
+        if (!handle.valid())
+        {
+            return;
+        }
+
+        const uint32_t slot = entryOf(handle);
+        if (slot >= m_entries.size())
+        {
+            m_entries.resize(slot + 1);
+        }
+
+        Entry &entry = m_entries[slot];
+        const uint32_t cell = cellOf(center(bounds));
+
+        if (entry.cell != UINT32_MAX && entry.handle != handle)
+        {
+            // slot was reused without the old object being removed
+            unlink(slot);
+            m_size--;
+        }
+
+        entry.handle = handle;
+        entry.bounds = bounds;
+        m_max_extent = std::max(m_max_extent, std::max(bounds.width(), bounds.height()) * 0.5f);
+
+        if (entry.cell == cell)
+        {
+            return;
+        }
+
+        if (entry.cell == UINT32_MAX)
+        {
+            m_size++;
+        }
+        else
+        {
+            unlink(slot);
+        }
+        link(slot, cell);
+    }
+
+    void SpatialGrid::remove(Handle handle)
+    {
+        const uint32_t slot = entryOf(handle);
+        if (slot >= m_entries.size() || m_entries[slot].cell == UINT32_MAX || m_entries[slot].handle != handle)
+        {
+            return;
+        }
+
+        unlink(slot);
+        m_size--;
+    }
+
+    void SpatialGrid::clear()
+    {
+        std::fill(m_cells.begin(), m_cells.end(), UINT32_MAX);
+        for (auto &entry : m_entries)
+        {
+            entry.cell = UINT32_MAX;
+        }
+        m_size = 0;
+        m_max_extent = 0;
+    }
+
+    size_t SpatialGrid::queryPoint(vec2f point, std::vector<Handle> &out) const
+    {
+        const size_t before = out.size();
+
+        int x0, y0, x1, y1;
+        cellRange(rectf(point, point), x0, y0, x1, y1);
+
+        for (int y = y0; y <= y1; y++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                for (uint32_t slot = m_cells[y * m_cols + x]; slot != UINT32_MAX; slot = m_entries[slot].next)
+                {
+                    const Entry &entry = m_entries[slot];
+                    // bounds are inclusive here, clicking the exact edge still counts
+                    if (point.x >= entry.bounds.min.x && point.x <= entry.bounds.max.x && point.y >= entry.bounds.min.y && point.y <= entry.bounds.max.y)
+                    {
+                        out.push_back(entry.handle);
+                    }
+                }
+            }
+        }
+
+        return out.size() - before;
+    }
+
+    size_t SpatialGrid::queryRect(const rectf &area, std::vector<Handle> &out) const
+    {
+        const size_t before = out.size();
+
+        int x0, y0, x1, y1;
+        cellRange(area, x0, y0, x1, y1);
+
+        for (int y = y0; y <= y1; y++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                for (uint32_t slot = m_cells[y * m_cols + x]; slot != UINT32_MAX; slot = m_entries[slot].next)
+                {
+                    if (m_entries[slot].bounds.intersects(area))
+                    {
+                        out.push_back(m_entries[slot].handle);
+                    }
+                }
+            }
+        }
+
+        return out.size() - before;
+    }
+
+    size_t SpatialGrid::nearestK(vec2f point, size_t k, std::vector<Handle> &out) const
+    {
+        if (k == 0 || m_size == 0)
+        {
+            return 0;
+        }
+
+        // max heap on distance, the worst of the best k on top
+        std::vector<std::pair<float, uint32_t>> best;
+        best.reserve(k + 1);
+
+        const uint32_t start = cellOf(point);
+        const int cx = (int)(start % m_cols);
+        const int cy = (int)(start / m_cols);
+
+        // the point may lie outside the grid, distances to other cells shrink by at most its distance to the start cell
+        const float ox = std::max({0.0f, cx * m_cell_size - point.x, point.x - (cx + 1) * m_cell_size});
+        const float oy = std::max({0.0f, cy * m_cell_size - point.y, point.y - (cy + 1) * m_cell_size});
+        const float outside = std::sqrt(ox * ox + oy * oy);
+
+        const int max_ring = std::max(m_cols, m_rows);
+        for (int ring = 0; ring <= max_ring; ring++)
+        {
+            for (int y = cy - ring; y <= cy + ring; y++)
+            {
+                if (y < 0 || y >= m_rows)
+                {
+                    continue;
+                }
+
+                // full rows at the ring's top and bottom edge, only the two side cells in between
+                const int step = (y == cy - ring || y == cy + ring) ? 1 : std::max(1, 2 * ring);
+                for (int x = cx - ring; x <= cx + ring; x += step)
+                {
+                    if (x < 0 || x >= m_cols)
+                    {
+                        continue;
+                    }
+
+                    for (uint32_t slot = m_cells[y * m_cols + x]; slot != UINT32_MAX; slot = m_entries[slot].next)
+                    {
+                        const float d2 = (center(m_entries[slot].bounds) - point).mag2();
+                        if (best.size() < k)
+                        {
+                            best.emplace_back(d2, slot);
+                            std::push_heap(best.begin(), best.end());
+                        }
+                        else if (d2 < best.front().first)
+                        {
+                            std::pop_heap(best.begin(), best.end());
+                            best.back() = {d2, slot};
+                            std::push_heap(best.begin(), best.end());
+                        }
+                    }
+                }
+            }
+
+            // every cell not visited yet is at least `ring` cells away from the start cell
+            const float reach = ring * m_cell_size - outside;
+            if (best.size() == k && reach > 0 && best.front().first <= reach * reach)
+            {
+                break;
+            }
+        }
+
+        std::sort_heap(best.begin(), best.end());
+        for (auto &b : best)
+        {
+            out.push_back(m_entries[b.second].handle);
+        }
+
+        return best.size();
+    }
+
+    size_t SpatialGrid::size() const
+    {
+        return m_size;
+    }
+}
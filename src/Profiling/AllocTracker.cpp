@@ -0,0 +1,317 @@
+#include "Profiling/AllocTracker.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <unistd.h>
+
+namespace alloc
+{
+    // Nothing in here may allocate, everything below is reached from inside malloc
+
+    struct Tag
+    {
+        std::atomic<const char *> name{nullptr};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+
+    // 0 is "untagged", the last one catches tags past MAX_TAGS
+    Tag m_tags[MAX_TAGS];
+    const uint32_t TAG_UNTAGGED = 0;
+    const uint32_t TAG_OTHER = MAX_TAGS - 1;
+
+    std::atomic<bool> m_strict(false);
+    std::atomic<uint64_t> m_violations(0);
+    std::atomic<const char *> m_last_violation(nullptr);
+
+    // plain values only, touched from inside the allocator
+    thread_local uint32_t t_tag = TAG_UNTAGGED;
+    thread_local const char *t_alloc_free = nullptr;
+
+    bool isEnabled()
+    {
+#ifdef WUI_ALLOC_TRACKING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void setStrict(bool strict)
+    {
+        m_strict = strict;
+    }
+
+    uint64_t getViolationCount()
+    {
+        return m_violations;
+    }
+
+    uint32_t tagIndex(const char *name)
+    {
+        for (uint32_t i = 1; i < TAG_OTHER; i++)
+        {
+            const char *current = m_tags[i].name.load(std::memory_order_acquire);
+            if (current == nullptr)
+            {
+                // claim the free slot, another thread may have taken it for the same or another name
+                if (m_tags[i].name.compare_exchange_strong(current, name, std::memory_order_acq_rel))
+                {
+                    return i;
+                }
+            }
+            if (strcmp(current, name) == 0)
+            {
+                return i;
+            }
+        }
+        return TAG_OTHER;
+    }
+
+    uint32_t swapTag(uint32_t tag)
+    {
+        const uint32_t previous = t_tag;
+        t_tag = tag;
+        return previous;
+    }
+
+    const char *swapAllocFree(const char *name)
+    {
+        const char *previous = t_alloc_free;
+        t_alloc_free = name;
+        return previous;
+    }
+
+    Counter getCounter(uint32_t tag)
+    {
+        return {m_tags[tag].count.load(std::memory_order_relaxed), m_tags[tag].bytes.load(std::memory_order_relaxed)};
+    }
+
+    const char *getTagName(uint32_t tag)
+    {
+        if (tag == TAG_UNTAGGED)
+        {
+            return "untagged";
+        }
+        if (tag == TAG_OTHER)
+        {
+            return "other";
+        }
+        return m_tags[tag].name.load();
+    }
+
+    inline void record(size_t bytes)
+    {
+        Tag &tag = m_tags[t_tag];
+        tag.count.fetch_add(1, std::memory_order_relaxed);
+        tag.bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+        if (t_alloc_free != nullptr)
+        {
+            m_violations.fetch_add(1, std::memory_order_relaxed);
+            m_last_violation.store(t_alloc_free, std::memory_order_relaxed);
+
+            if (m_strict.load(std::memory_order_relaxed))
+            {
+                // no formatting, that would allocate again
+                const char prefix[] = "[Alloc] allocation inside allocation-free region: ";
+                (void)!write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+                (void)!write(STDERR_FILENO, t_alloc_free, strlen(t_alloc_free));
+                (void)!write(STDERR_FILENO, "\n", 1);
+                abort();
+            }
+        }
+    }
+
+    void logReport()
+    {
+        if (!isEnabled())
+        {
+            return;
+        }
+
+        spdlog::info("[Alloc] {:<24} {:>12} {:>14}", "tag", "allocations", "bytes");
+        for (uint32_t i = 0; i < MAX_TAGS; i++)
+        {
+            const Counter c = getCounter(i);
+            if (c.count > 0)
+            {
+                spdlog::info("[Alloc] {:<24} {:>12} {:>14}", getTagName(i), c.count, c.bytes);
+            }
+        }
+
+        if (m_violations > 0)
+        {
+            spdlog::warn("[Alloc] {} allocations inside allocation-free regions, last in '{}'", m_violations.load(), m_last_violation.load());
+        }
+    }
+
+    void FrameCounter::frameEnd(size_t renderer_index)
+    {
+        if (!isEnabled())
+        {
+            return;
+        }
+
+        for (uint32_t i = 0; i < MAX_TAGS; i++)
+        {
+            const Counter now = getCounter(i);
+            m_window[i].count += now.count - m_last[i].count;
+            m_window[i].bytes += now.bytes - m_last[i].bytes;
+            m_last[i] = now;
+        }
+        m_frames++;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_window_start < std::chrono::seconds(1))
+        {
+            return;
+        }
+
+        Counter total;
+        for (uint32_t i = 0; i < MAX_TAGS; i++)
+        {
+            total.count += m_window[i].count;
+            total.bytes += m_window[i].bytes;
+        }
+
+        spdlog::info("[Alloc] renderer {}: {:.1f} allocations / {:.0f} bytes per frame over {} frames",
+                     renderer_index, (double)total.count / m_frames, (double)total.bytes / m_frames, m_frames);
+        for (uint32_t i = 0; i < MAX_TAGS; i++)
+        {
+            if (m_window[i].count > 0)
+            {
+                spdlog::info("[Alloc]   {:<24} {:>10.1f} {:>12.0f}", getTagName(i), (double)m_window[i].count / m_frames, (double)m_window[i].bytes / m_frames);
+            }
+            m_window[i] = {};
+        }
+
+        m_frames = 0;
+        m_window_start = now;
+    }
+}
+
+#ifdef WUI_ALLOC_TRACKING
+
+#if defined(__GLIBC__)
+
+// Interpose the C allocator, libstdc++'s operator new and every shared library (CEF, cJSON) end up here
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void *__libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void *ptr);
+
+    void *malloc(size_t size)
+    {
+        alloc::record(size);
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        alloc::record(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        alloc::record(size);
+        return __libc_realloc(ptr, size);
+    }
+
+    void *memalign(size_t alignment, size_t size)
+    {
+        alloc::record(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    void *aligned_alloc(size_t alignment, size_t size)
+    {
+        alloc::record(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void **out, size_t alignment, size_t size)
+    {
+        if (alignment < sizeof(void *) || (alignment & (alignment - 1)) != 0)
+        {
+            return EINVAL;
+        }
+
+        alloc::record(size);
+        void *ptr = __libc_memalign(alignment, size);
+        if (ptr == nullptr)
+        {
+            return ENOMEM;
+        }
+        *out = ptr;
+        return 0;
+    }
+
+    void free(void *ptr)
+    {
+        __libc_free(ptr);
+    }
+}
+
+#else
+
+// No portable way to interpose malloc, count C++ allocations only
+void *operator new(size_t size)
+{
+    alloc::record(size);
+    if (void *ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    alloc::record(size);
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,467 @@
+#include "Profiling/Metrics.hpp"
+#include "Profiling/AllocTracker.hpp"
+#include "Threads/Topology.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace metrics
+{
+    namespace
+    {
+        enum class Kind
+        {
+            COUNTER,
+            GAUGE,
+            HISTOGRAM,
+        };
+
+        struct Entry
+        {
+            Kind kind;
+            const char *name;
+            const char *help;
+            const void *metric;
+            uint32_t slot;
+        };
+
+        struct ThreadBlock
+        {
+            std::atomic<uint64_t> slots[MAX_SLOTS];
+
+            ThreadBlock()
+            {
+                for (auto &slot : slots)
+                {
+                    slot.store(0, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        // Function local so metrics defined at namespace scope in other translation units can register during static init
+        struct Registry
+        {
+            std::mutex lock;
+            std::vector<Entry> entries;
+            uint32_t next_slot = 0;
+
+            // never freed, a thread's counts stay part of the totals after it exits
+            std::vector<ThreadBlock *> blocks;
+
+            std::vector<std::function<void(std::string &)>> collectors;
+        };
+
+        Registry &registry()
+        {
+            static Registry r;
+            return r;
+        }
+
+        thread_local ThreadBlock *t_block = nullptr;
+
+        ThreadBlock &threadBlock()
+        {
+            if (t_block == nullptr)
+            {
+                t_block = new ThreadBlock();
+                auto &r = registry();
+                r.lock.lock();
+                r.blocks.push_back(t_block);
+                r.lock.unlock();
+            }
+            return *t_block;
+        }
+
+        uint32_t registerMetric(Kind kind, const char *name, const char *help, const void *metric, uint32_t slots)
+        {
+            auto &r = registry();
+            r.lock.lock();
+            const uint32_t slot = r.next_slot;
+            if (slot + slots > MAX_SLOTS)
+            {
+                // release builds would write past the per thread blocks
+                r.lock.unlock();
+                spdlog::error("[Metrics] {} needs {} slots, only {} of {} are left, raise MAX_SLOTS", name, slots, MAX_SLOTS - slot, MAX_SLOTS);
+                exit(1);
+            }
+            r.next_slot += slots;
+            r.entries.push_back({kind, name, help, metric, slot});
+            r.lock.unlock();
+            return slot;
+        }
+
+        // only the owning thread writes its block, no read-modify-write needed
+        inline void addToSlot(uint32_t slot, uint64_t value)
+        {
+            auto &s = threadBlock().slots[slot];
+            s.store(s.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        inline void addToDoubleSlot(uint32_t slot, double value)
+        {
+            auto &s = threadBlock().slots[slot];
+            double current;
+            const uint64_t bits = s.load(std::memory_order_relaxed);
+            memcpy(&current, &bits, sizeof(current));
+            current += value;
+            uint64_t next;
+            memcpy(&next, &current, sizeof(next));
+            s.store(next, std::memory_order_relaxed);
+        }
+
+        // registry lock held
+        uint64_t sumSlot(const Registry &r, uint32_t slot)
+        {
+            uint64_t ret = 0;
+            for (auto block : r.blocks)
+            {
+                ret += block->slots[slot].load(std::memory_order_relaxed);
+            }
+            return ret;
+        }
+
+        double sumDoubleSlot(const Registry &r, uint32_t slot)
+        {
+            double ret = 0;
+            for (auto block : r.blocks)
+            {
+                const uint64_t bits = block->slots[slot].load(std::memory_order_relaxed);
+                double value;
+                memcpy(&value, &bits, sizeof(value));
+                ret += value;
+            }
+            return ret;
+        }
+
+        void writeHeader(std::string &out, const Entry &entry, const char *type)
+        {
+            fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", entry.name, entry.help, entry.name, type);
+        }
+
+        // allocation tracker totals per tag, only in WUI_ALLOC_TRACKING builds
+        void collectAllocations(std::string &out)
+        {
+            if (!alloc::isEnabled())
+            {
+                return;
+            }
+
+            out += "# HELP wui_allocations_total Heap allocations by subsystem tag\n# TYPE wui_allocations_total counter\n";
+            for (uint32_t i = 0; i < alloc::MAX_TAGS; i++)
+            {
+                const alloc::Counter c = alloc::getCounter(i);
+                if (c.count > 0)
+                {
+                    fmt::format_to(std::back_inserter(out), "wui_allocations_total{{tag=\"{}\"}} {}\n", alloc::getTagName(i), c.count);
+                }
+            }
+
+            out += "# HELP wui_allocated_bytes_total Heap bytes allocated by subsystem tag\n# TYPE wui_allocated_bytes_total counter\n";
+            for (uint32_t i = 0; i < alloc::MAX_TAGS; i++)
+            {
+                const alloc::Counter c = alloc::getCounter(i);
+                if (c.count > 0)
+                {
+                    fmt::format_to(std::back_inserter(out), "wui_allocated_bytes_total{{tag=\"{}\"}} {}\n", alloc::getTagName(i), c.bytes);
+                }
+            }
+
+            fmt::format_to(std::back_inserter(out), "# HELP wui_alloc_free_violations_total Allocations inside allocation-free regions\n"
+                                                    "# TYPE wui_alloc_free_violations_total counter\nwui_alloc_free_violations_total {}\n",
+                           alloc::getViolationCount());
+        }
+
+        std::atomic<int> m_server_fd(-1);
+        std::string m_unix_path;
+
+        void serveClient(int fd)
+        {
+            // the request itself does not matter, read (up to) its header so the client does not see a reset
+            timeval timeout = {1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+            char request[4096];
+            size_t received = 0;
+            while (received < sizeof(request) - 1)
+            {
+                const ssize_t n = recv(fd, request + received, sizeof(request) - 1 - received, 0);
+                if (n <= 0)
+                {
+                    break;
+                }
+                received += n;
+                request[received] = '\0';
+                if (strstr(request, "\r\n\r\n") != nullptr || strstr(request, "\n\n") != nullptr)
+                {
+                    break;
+                }
+            }
+
+            std::string body;
+            writeText(body);
+
+            std::string response = fmt::format("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: {}\r\nConnection: close\r\n\r\n", body.size());
+            response += body;
+
+            size_t sent = 0;
+            while (sent < response.size())
+            {
+                const ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0)
+                {
+                    break;
+                }
+                sent += n;
+            }
+        }
+    }
+
+    Counter::Counter(const char *name, const char *help) : m_slot(registerMetric(Kind::COUNTER, name, help, this, 1))
+    {
+    }
+
+    void Counter::inc(uint64_t value)
+    {
+        addToSlot(m_slot, value);
+    }
+
+    uint64_t Counter::get() const
+    {
+        auto &r = registry();
+        r.lock.lock();
+        const uint64_t ret = sumSlot(r, m_slot);
+        r.lock.unlock();
+        return ret;
+    }
+
+    Gauge::Gauge(const char *name, const char *help)
+    {
+        registerMetric(Kind::GAUGE, name, help, this, 0);
+    }
+
+    Histogram::Histogram(const char *name, const char *help, std::initializer_list<double> bounds)
+    {
+        if (bounds.size() > MAX_BUCKETS)
+        {
+            spdlog::error("[Metrics] {} has {} buckets, at most {}", name, bounds.size(), MAX_BUCKETS);
+            exit(1);
+        }
+        for (double bound : bounds)
+        {
+            m_bounds[m_bucket_count++] = bound;
+        }
+        m_slot = registerMetric(Kind::HISTOGRAM, name, help, this, m_bucket_count + 2);
+    }
+
+    void Histogram::observe(double value)
+    {
+        size_t bucket = 0;
+        while (bucket < m_bucket_count && value > m_bounds[bucket])
+        {
+            bucket++;
+        }
+
+        addToSlot(m_slot + bucket, 1);
+        addToDoubleSlot(m_slot + m_bucket_count + 1, value);
+    }
+
+    void addCollector(std::function<void(std::string &out)> collector)
+    {
+        auto &r = registry();
+        r.lock.lock();
+        r.collectors.push_back(std::move(collector));
+        r.lock.unlock();
+    }
+
+    void writeText(std::string &out)
+    {
+        auto &r = registry();
+        r.lock.lock();
+
+        for (const Entry &entry : r.entries)
+        {
+            switch (entry.kind)
+            {
+            case Kind::COUNTER:
+                writeHeader(out, entry, "counter");
+                fmt::format_to(std::back_inserter(out), "{} {}\n", entry.name, sumSlot(r, entry.slot));
+                break;
+
+            case Kind::GAUGE:
+                writeHeader(out, entry, "gauge");
+                fmt::format_to(std::back_inserter(out), "{} {}\n", entry.name, static_cast<const Gauge *>(entry.metric)->get());
+                break;
+
+            case Kind::HISTOGRAM:
+            {
+                const Histogram &h = *static_cast<const Histogram *>(entry.metric);
+                writeHeader(out, entry, "histogram");
+
+                // buckets are stored individually, Prometheus wants them cumulative
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i < h.m_bucket_count; i++)
+                {
+                    cumulative += sumSlot(r, entry.slot + i);
+                    fmt::format_to(std::back_inserter(out), "{}_bucket{{le=\"{}\"}} {}\n", entry.name, h.m_bounds[i], cumulative);
+                }
+                cumulative += sumSlot(r, entry.slot + h.m_bucket_count);
+                fmt::format_to(std::back_inserter(out), "{}_bucket{{le=\"+Inf\"}} {}\n", entry.name, cumulative);
+                fmt::format_to(std::back_inserter(out), "{}_sum {}\n", entry.name, sumDoubleSlot(r, entry.slot + h.m_bucket_count + 1));
+                fmt::format_to(std::back_inserter(out), "{}_count {}\n", entry.name, cumulative);
+                break;
+            }
+            }
+        }
+
+        const auto collectors = r.collectors;
+        r.lock.unlock();
+
+        collectAllocations(out);
+        for (auto &collector : collectors)
+        {
+            collector(out);
+        }
+    }
+
+    bool startServer(const std::string &address)
+    {
+        if (m_server_fd >= 0)
+        {
+            spdlog::warn("[Metrics] server already running");
+            return false;
+        }
+
+        int fd = -1;
+        if (address.rfind("unix:", 0) == 0)
+        {
+            const std::string path = address.substr(5);
+            sockaddr_un addr = {};
+            if (path.empty() || path.size() >= sizeof(addr.sun_path))
+            {
+                spdlog::error("[Metrics] invalid socket path '{}'", path);
+                return false;
+            }
+            addr.sun_family = AF_UNIX;
+            memcpy(addr.sun_path, path.c_str(), path.size());
+
+            // a socket left behind by a previous run, anything else at the path is not ours to delete
+            struct stat st;
+            if (lstat(path.c_str(), &st) == 0)
+            {
+                if (!S_ISSOCK(st.st_mode))
+                {
+                    spdlog::error("[Metrics] {} exists and is not a socket, not replacing it", path);
+                    return false;
+                }
+                unlink(path.c_str());
+            }
+
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+            {
+                spdlog::error("[Metrics] could not bind {}: {}", path, strerror(errno));
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+                return false;
+            }
+            m_unix_path = path;
+        }
+        else
+        {
+            const int port = atoi(address.c_str());
+            if (port <= 0 || port > 65535)
+            {
+                spdlog::error("[Metrics] invalid address '{}', expected a port or unix:/path", address);
+                return false;
+            }
+
+            // loopback only, the metrics are not meant to leave the machine
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            const int reuse = 1;
+            if (fd >= 0)
+            {
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            }
+            if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+            {
+                spdlog::error("[Metrics] could not bind 127.0.0.1:{}: {}", port, strerror(errno));
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+                return false;
+            }
+        }
+
+        if (listen(fd, 8) != 0)
+        {
+            spdlog::error("[Metrics] could not listen on {}: {}", address, strerror(errno));
+            close(fd);
+            return false;
+        }
+
+        m_server_fd = fd;
+        spdlog::info("[Metrics] serving on {}", address);
+
+        std::thread([fd]() -> void
+                    {
+                        threads::registerCurrent(threads::Role::LISTENER, "metrics");
+                        while (true)
+                        {
+                            const int client = accept(fd, nullptr, nullptr);
+                            if (client < 0)
+                            {
+                                if (errno == EINTR || errno == ECONNABORTED)
+                                {
+                                    continue;
+                                }
+                                break; // closed by stopServer
+                            }
+
+                            serveClient(client);
+                            close(client);
+                        }
+                        spdlog::info("[Metrics] server stopped"); })
+            .detach();
+
+        return true;
+    }
+
+    void stopServer()
+    {
+        const int fd = m_server_fd.exchange(-1);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        shutdown(fd, SHUT_RDWR); // wakes up accept
+        close(fd);
+
+        if (!m_unix_path.empty())
+        {
+            unlink(m_unix_path.c_str());
+            m_unix_path.clear();
+        }
+    }
+}
@@ -0,0 +1,214 @@
+#include "Renderer/PerfHud.hpp"
+#include "Input/Input.hpp"
+
+#include <allegro5/allegro_primitives.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <mutex>
+
+namespace render
+{
+    namespace
+    {
+        const float PADDING = 6;
+        const float GRAPH_HEIGHT = 60;
+        const float GRAPH_BAR_WIDTH = 2; // px per frame
+        const float GRAPH_MIN_SCALE_MS = 33.4f; // graph spans at least two 60 fps frames
+        const float TARGET_FRAME_MS = 1000.0f / 60;
+
+        std::once_flag m_font_addon_once; // every renderer's thread may be the first to show its HUD
+    }
+
+    constexpr std::chrono::milliseconds PerfHud::TEXT_INTERVAL;
+
+    PerfHud::~PerfHud()
+    {
+        release();
+    }
+
+    void PerfHud::toggle()
+    {
+        m_visible = !m_visible;
+    }
+
+    void PerfHud::setVisible(bool visible)
+    {
+        m_visible = visible;
+    }
+
+    bool PerfHud::isVisible() const
+    {
+        return m_visible;
+    }
+
+    void PerfHud::record(const FrameTimings &frame)
+    {
+        if (!m_visible)
+        {
+            return;
+        }
+
+        m_history[m_history_next] = (float)frame.total_ms;
+        m_history_next = (m_history_next + 1) % HISTORY;
+
+        m_sum.total_ms += frame.total_ms;
+        m_sum.ui_ms += frame.ui_ms;
+        m_sum.simulate_ms += frame.simulate_ms;
+        m_sum.draw_ms += frame.draw_ms;
+        m_sum.send_ms += frame.send_ms;
+        m_sum.present_ms += frame.present_ms;
+        m_sum.ui_copied_bytes += frame.ui_copied_bytes;
+        m_sum.ui_uploaded_bytes += frame.ui_uploaded_bytes;
+        m_sum_frames++;
+        m_max_frame_ms = std::max(m_max_frame_ms, frame.total_ms);
+        m_last = frame;
+    }
+
+    void PerfHud::rebuildText()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const double elapsed_s = std::chrono::duration<double>(now - m_last_rebuild).count();
+        m_last_rebuild = now;
+
+        const size_t input_events = input::getEventCount();
+        const double input_rate = elapsed_s > 0 ? (input_events - m_last_input_events) / elapsed_s : 0;
+        m_last_input_events = input_events;
+
+        const double n = std::max<size_t>(1, m_sum_frames);
+        const double frame_ms = m_sum.total_ms / n;
+
+        m_lines.clear();
+        m_lines.push_back(fmt::format("{:5.1f} fps  {:5.2f} ms  (max {:5.2f})", elapsed_s > 0 ? m_sum_frames / elapsed_s : 0.0, frame_ms, m_max_frame_ms));
+        m_lines.push_back(fmt::format("ui   {:5.2f}  sim  {:5.2f}  draw {:5.2f} ms", m_sum.ui_ms / n, m_sum.simulate_ms / n, m_sum.draw_ms / n));
+        m_lines.push_back(fmt::format("send {:5.2f}  present {:5.2f} ms", m_sum.send_ms / n, m_sum.present_ms / n));
+        m_lines.push_back(fmt::format("objects {}  culled {}", m_last.objects, m_last.culled));
+        m_lines.push_back(fmt::format("osr copy {:.1f} KiB  upload {:.1f} KiB / frame", m_sum.ui_copied_bytes / n / 1024, m_sum.ui_uploaded_bytes / n / 1024));
+        m_lines.push_back(fmt::format("input {:.0f} ev/s  ui events in flight {}", input_rate, m_last.ui_events_in_flight));
+
+        m_sum = FrameTimings();
+        m_sum_frames = 0;
+        m_max_frame_ms = 0;
+
+        // render the text once, every frame until the next rebuild only blits it
+        const int line_height = al_get_font_line_height(m_font);
+        int text_width = (int)(HISTORY * GRAPH_BAR_WIDTH);
+        for (auto &line : m_lines)
+        {
+            text_width = std::max(text_width, al_get_text_width(m_font, line.c_str()));
+        }
+        const int w = text_width + 2 * PADDING;
+        const int h = (int)m_lines.size() * line_height + 2 * PADDING;
+
+        if (m_text_bitmap == nullptr || al_get_bitmap_width(m_text_bitmap) < w || al_get_bitmap_height(m_text_bitmap) != h)
+        {
+            if (m_text_bitmap != nullptr)
+            {
+                al_destroy_bitmap(m_text_bitmap);
+            }
+            m_text_bitmap = al_create_bitmap(w, h);
+            if (m_text_bitmap == nullptr)
+            {
+                spdlog::error("[PerfHud] could not create text bitmap");
+                return;
+            }
+        }
+
+        ALLEGRO_BITMAP *target = al_get_target_bitmap();
+        al_set_target_bitmap(m_text_bitmap);
+        al_clear_to_color(al_map_rgba(0, 0, 0, 180));
+        for (size_t i = 0; i < m_lines.size(); i++)
+        {
+            al_draw_text(m_font, al_map_rgb(230, 230, 230), PADDING, PADDING + i * line_height, ALLEGRO_ALIGN_LEFT, m_lines[i].c_str());
+        }
+        al_set_target_bitmap(target);
+    }
+
+    void PerfHud::draw(float x, float y)
+    {
+        if (!m_visible)
+        {
+            m_active = false;
+            return;
+        }
+
+        if (m_font == nullptr)
+        {
+            std::call_once(m_font_addon_once, []()
+                           {
+                               if (!al_init_font_addon())
+                               {
+                                   spdlog::error("[PerfHud] could not initialize the font addon");
+                               } });
+            m_font = al_create_builtin_font();
+            if (m_font == nullptr)
+            {
+                spdlog::error("[PerfHud] could not create font, hiding the HUD");
+                m_visible = false;
+                return;
+            }
+        }
+
+        // first frame shown since being hidden, start the averages fresh
+        if (!m_active)
+        {
+            m_active = true;
+            std::fill(std::begin(m_history), std::end(m_history), 0.0f);
+            m_sum = FrameTimings();
+            m_sum_frames = 0;
+            m_max_frame_ms = 0;
+            m_last_rebuild = std::chrono::steady_clock::now();
+            m_last_input_events = input::getEventCount();
+            rebuildText();
+        }
+
+        if (std::chrono::steady_clock::now() - m_last_rebuild >= TEXT_INTERVAL)
+        {
+            rebuildText();
+        }
+
+        if (m_text_bitmap == nullptr)
+        {
+            return;
+        }
+        al_draw_bitmap(m_text_bitmap, x, y, 0);
+
+        // frame time graph below the text, oldest frame on the left
+        const float graph_w = HISTORY * GRAPH_BAR_WIDTH;
+        const float gx = x;
+        const float gy = y + al_get_bitmap_height(m_text_bitmap);
+        al_draw_filled_rectangle(gx, gy, gx + graph_w, gy + GRAPH_HEIGHT, al_map_rgba(0, 0, 0, 180));
+
+        float scale_ms = GRAPH_MIN_SCALE_MS;
+        for (float ms : m_history)
+        {
+            scale_ms = std::max(scale_ms, ms);
+        }
+
+        const float target_y = gy + GRAPH_HEIGHT - TARGET_FRAME_MS / scale_ms * GRAPH_HEIGHT;
+        al_draw_line(gx, target_y, gx + graph_w, target_y, al_map_rgb(60, 120, 60), 1);
+
+        ALLEGRO_VERTEX strip[HISTORY];
+        const ALLEGRO_COLOR color = al_map_rgb(255, 200, 40);
+        for (size_t i = 0; i < HISTORY; i++)
+        {
+            const float ms = m_history[(m_history_next + i) % HISTORY];
+            strip[i] = {gx + i * GRAPH_BAR_WIDTH, gy + GRAPH_HEIGHT - ms / scale_ms * GRAPH_HEIGHT, 0, 0, 0, color};
+        }
+        al_draw_prim(strip, nullptr, nullptr, 0, HISTORY, ALLEGRO_PRIM_LINE_STRIP);
+    }
+
+    void PerfHud::release()
+    {
+        if (m_text_bitmap != nullptr)
+        {
+            al_destroy_bitmap(m_text_bitmap);
+            m_text_bitmap = nullptr;
+        }
+        if (m_font != nullptr)
+        {
+            al_destroy_font(m_font);
+            m_font = nullptr;
+        }
+    }
+}
@@ -2,22 +2,192 @@
 #include "spdlog/spdlog.h"
 #include "webUi.hpp"
 #include "webUiBinding.hpp"
+#include "webUiInput.hpp"
 
 #include <allegro5/allegro_primitives.h>
 #include "Objects/Ball.hpp"
+#include "Math/vec_simd.hpp"
+#include "Jobs/JobSystem.hpp"
+#include "Logging/Logging.hpp"
+#include "Threads/Topology.hpp"
+#include "Profiling/AllocTracker.hpp"
+#include "Profiling/Metrics.hpp"
+#include "Startup/Startup.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 namespace render
 {
-    Renderer renderer = render::Renderer();
+    metrics::Counter m_frames_metric("wui_frames_total", "Frames presented, all renderers");
+    metrics::Histogram m_frame_time_metric("wui_frame_time_seconds", "Render thread time per frame",
+                                           {0.002, 0.004, 0.008, 0.0167, 0.033, 0.05, 0.1, 0.25});
+    metrics::Counter m_ui_frames_dropped_metric("wui_ui_frames_dropped_total", "Frames drawn without taking a new UI frame, the OSR buffer was busy");
+    metrics::Counter m_ui_events_sent_metric("wui_ui_events_sent_total", "BallInfo messages sent to the UI");
+    metrics::Counter m_ui_events_skipped_metric("wui_ui_events_skipped_total", "BallInfo messages skipped while the UI lagged behind");
+    metrics::Counter m_ui_commands_metric("wui_ui_commands_total", "Commands received from the UI, batched ones counted individually");
+    metrics::Gauge m_objects_metric("wui_objects_alive", "Objects alive, all renderers");
+    metrics::Gauge m_energy_metric("wui_scene_kinetic_energy", "Kinetic energy of all objects (radius^2 as mass, px^2/s^2), all renderers");
+
+    std::atomic<size_t> m_max_ui_events_in_flight(2);
+
+    // Unacknowledged messages older than this are assumed lost (page reloaded, listener gone), sending resumes
+    const std::chrono::milliseconds UI_ACK_TIMEOUT(1000);
+
+    void setMaxUiEventsInFlight(size_t count)
+    {
+        m_max_ui_events_in_flight = count;
+    }
+
+    std::atomic<float> m_default_ui_scale(1.0f);
+
+    void setDefaultUiScale(float scale)
+    {
+        m_default_ui_scale = std::clamp(scale, MIN_UI_SCALE, 1.0f);
+    }
+
+    recti m_default_ui_viewport; // only written before renderers are created
+
+    std::atomic<bool> m_default_hud_visible(false);
+
+    void setDefaultPerfHudVisible(bool visible)
+    {
+        m_default_hud_visible = visible;
+    }
+
+    void setDefaultUiViewport(const recti &viewport)
+    {
+        m_default_ui_viewport = viewport;
+    }
+
+    std::vector<UiLayerConfig> m_default_ui_layers; // only written before renderers are created
+
+    void addDefaultUiLayer(const UiLayerConfig &config)
+    {
+        m_default_ui_layers.push_back(config);
+    }
+
+    std::atomic<bool> m_default_ui_prewarm(false);
+
+    void setDefaultUiPrewarm(bool prewarm)
+    {
+        m_default_ui_prewarm = prewarm;
+    }
+
+    std::atomic<bool> m_default_headless(false);
+
+    void setDefaultHeadless(bool headless)
+    {
+        m_default_headless = headless;
+    }
+
+    std::atomic<bool> m_default_soft_raster(true);
+
+    void setDefaultSoftRaster(bool soft_raster)
+    {
+        m_default_soft_raster = soft_raster;
+    }
 
-    Renderer::Renderer()
+    std::atomic<bool> m_default_vsync(true);
+
+    void setDefaultVsync(bool vsync)
+    {
+        m_default_vsync = vsync;
+    }
+
+    // Registry of all renderers, owned here so they outlive every thread that may route events to them
+    std::mutex l_renderers;
+    std::vector<std::unique_ptr<Renderer>> m_renderers;
+    std::atomic<Renderer *> m_focused_renderer(nullptr);
+
+    Renderer *createRenderer(size_t width, size_t height)
+    {
+        l_renderers.lock();
+        m_renderers.push_back(std::make_unique<Renderer>(m_renderers.size(), width, height));
+        auto ret = m_renderers.back().get();
+        l_renderers.unlock();
+        return ret;
+    }
+
+    std::vector<Renderer *> getRenderers()
+    {
+        std::vector<Renderer *> ret;
+        l_renderers.lock();
+        for (auto &r : m_renderers)
+        {
+            ret.push_back(r.get());
+        }
+        l_renderers.unlock();
+        return ret;
+    }
+
+    Renderer *getRenderer(const ALLEGRO_DISPLAY *display)
+    {
+        if (display == nullptr)
+        {
+            return nullptr;
+        }
+
+        Renderer *ret = nullptr;
+        l_renderers.lock();
+        for (auto &r : m_renderers)
+        {
+            if (r->getDisplay() == display)
+            {
+                ret = r.get();
+                break;
+            }
+        }
+        l_renderers.unlock();
+        return ret;
+    }
+
+    Renderer *getFocusedRenderer()
     {
+        auto focused = m_focused_renderer.load();
+        if (focused != nullptr)
+        {
+            return focused;
+        }
+
+        Renderer *ret = nullptr;
+        l_renderers.lock();
+        if (!m_renderers.empty())
+        {
+            ret = m_renderers.front().get();
+        }
+        l_renderers.unlock();
+        return ret;
+    }
+
+    Renderer::Renderer(size_t index, size_t width, size_t height) : height(height), width(width), m_index(index)
+    {
+        UiLayerConfig main_layer;
+        main_layer.name = MAIN_UI_LAYER;
+        main_layer.viewport = m_default_ui_viewport;
+        main_layer.scale = m_default_ui_scale;
+        m_layers.push_back(std::make_unique<UiLayer>(main_layer, width, height));
+        m_main_layer = m_layers.back().get();
+
+        for (const auto &config : m_default_ui_layers)
+        {
+            m_layers.push_back(std::make_unique<UiLayer>(config, width, height));
+        }
+        std::stable_sort(m_layers.begin(), m_layers.end(), [](const std::unique_ptr<UiLayer> &a, const std::unique_ptr<UiLayer> &b)
+                         { return a->getZ() < b->getZ(); });
+        m_focused_layer = m_main_layer;
+
+        m_hud.setVisible(m_default_hud_visible);
+        m_headless = m_default_headless;
+        m_soft_raster = m_headless && m_default_soft_raster;
+        m_prewarm_ui = m_default_ui_prewarm;
     }
 
     Renderer::~Renderer()
     {
         if (m_render_thread.joinable())
         {
-            spdlog::info("[Renderer] Joining render thread");
+            spdlog::info("[Renderer {}] Joining render thread", m_index);
             m_render_thread.join();
         }
     }
@@ -27,25 +197,58 @@ namespace render
 
         al_init_primitives_addon();
 
-        al_set_new_display_flags(ALLEGRO_RESIZABLE | ALLEGRO_WINDOWED);
+        if (m_headless)
+        {
+            // no display on this thread, so bitmaps created from here on are memory bitmaps and drawing is software
+            // the rasterizer writes ARGB_8888, locking the target in its own format is free
+            const int old_format = al_get_new_bitmap_format();
+            al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ARGB_8888);
+            m_headless_target = al_create_bitmap(width, height);
+            al_set_new_bitmap_format(old_format);
+            if (!m_headless_target)
+            {
+                spdlog::error("Failed to create headless render target");
+                exit(1);
+            }
+            al_set_target_bitmap(m_headless_target);
 
-        m_display = al_create_display(width, height);
+            if (m_soft_raster)
+            {
+                m_rasterizer.resize(width, height);
+            }
+        }
+        else
+        {
+            al_set_new_display_flags(ALLEGRO_RESIZABLE | ALLEGRO_WINDOWED);
 
-        al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP); // use memory bitmap for OSR buffer
+            // 2 forces it off, 1 on (if the driver lets us), new display options are per thread
+            al_set_new_display_option(ALLEGRO_VSYNC, m_default_vsync ? 1 : 2, ALLEGRO_SUGGEST);
 
-        m_osr_buffer = al_create_bitmap(width, height);
+            // stagger additional windows so they do not stack exactly on top of each other
+            if (m_index > 0)
+            {
+                al_set_new_window_position(64 + 32 * m_index, 64 + 32 * m_index);
+            }
 
-        if (!m_display || !m_osr_buffer)
-        {
-            spdlog::error("Failed to create display or OSR bitmap buffer");
-            exit(1);
+            m_display = al_create_display(width, height);
+
+            if (!m_display)
+            {
+                spdlog::error("Failed to create display");
+                exit(1);
+            }
         }
 
-        // clear entire bitmap to white (osr buffer)
+        // OSR buffers, start out fully transparent
         // NOTE: Allegro pixel buffers are High -> LOW, so on ALLEGRO_PIXEL_FORMAT_ARGB_8888, a buffer access at [0] = Blue
-        auto locked_region = al_lock_bitmap(m_osr_buffer, ALLEGRO_PIXEL_FORMAT_ARGB_8888, ALLEGRO_LOCK_WRITEONLY);
-        memset(locked_region->data, 0, width * height * 4);
-        al_unlock_bitmap(m_osr_buffer);
+        for (auto &layer : m_layers)
+        {
+            layer->applyPending(width, height, true);
+        }
+
+        m_l_renderables.lock();
+        m_grid.resize(width, height);
+        m_l_renderables.unlock();
 
         m_timer = al_create_timer(1.0 / fps);
         if (!m_timer)
@@ -62,15 +265,20 @@ namespace render
             exit(1);
         }
 
-        // Register event sources
-        al_register_event_source(m_event_queue, al_get_display_event_source(m_display));
+        // Register event sources, headless renderers are only driven by the timer
         al_register_event_source(m_event_queue, al_get_timer_event_source(m_timer));
 
         // Display a black screen, clear the screen once
         al_clear_to_color(al_map_rgb(0, 0, 0));
-        al_flip_display();
 
-        spdlog::info("Renderer initialized");
+        if (!m_headless)
+        {
+            al_register_event_source(m_event_queue, al_get_display_event_source(m_display));
+            al_set_window_title(m_display, fmt::format("wui_example [{}]", m_index).c_str());
+            al_flip_display();
+        }
+
+        spdlog::info("[Renderer {}] initialized{}", m_index, m_headless ? " (headless)" : "");
     }
 
     void Renderer::deinit()
@@ -80,12 +288,41 @@ namespace render
         m_timer = nullptr;
         al_destroy_event_queue(m_event_queue);
         m_event_queue = nullptr;
-        al_destroy_bitmap(m_osr_buffer);
-        m_osr_buffer = nullptr;
-        al_destroy_display(m_display);
-        m_display = nullptr;
+        for (auto &layer : m_layers)
+        {
+            layer->releaseSurface();
+        }
+        m_hud.release();
+
+        m_objects_metric.add(-(int64_t)m_reported_objects);
+        m_reported_objects = 0;
+        m_energy_metric.add(-m_reported_energy);
+        m_reported_energy = 0;
+
+        auto stats = getPoolStats();
+        spdlog::info("[Renderer {}] object pool: {} created, {} destroyed, peak {} live, {} chunk allocations",
+                     m_index, stats.created, stats.destroyed, stats.peak_live, stats.chunk_allocations);
+        spdlog::info("[Renderer {}] BallInfo: {} sent, {} frames skipped while the UI lagged", m_index, m_info_sent.load(), m_info_skipped.load());
+        clearObjects();
+        Renderer *self = this;
+        m_focused_renderer.compare_exchange_strong(self, nullptr);
+
+        if (m_headless_target != nullptr)
+        {
+            al_set_target_bitmap(nullptr);
+            al_destroy_bitmap(m_headless_target);
+            m_headless_target = nullptr;
+        }
+
+        if (m_display != nullptr)
+        {
+            l_renderers.lock(); // getRenderer() compares against the display
+            al_destroy_display(m_display);
+            m_display = nullptr;
+            l_renderers.unlock();
+        }
 
-        spdlog::info("Renderer deinitialized");
+        spdlog::info("[Renderer {}] deinitialized", m_index);
     }
 
     void Renderer::renderLoop()
@@ -94,11 +331,19 @@ namespace render
         // this is very important: OpenGL can only draw to a display if the display was created by that thread
         // This is becuase of the opengl context being tied to the thread. This is not a bug and stems from opengl
         // Opengl is not really multi-thread draw-safe
-        this->init();
+        threads::registerCurrent(threads::Role::RENDER, fmt::format("render-{}", m_index));
+        {
+            startup::Phase phase(fmt::format("renderer {} display", m_index));
+            this->init();
+        }
 
-        restartWui();
+        if (m_open_wui_on_start)
+        {
+            restartWui();
+        }
 
         // Start the timer
+        m_last_frame_time = std::chrono::high_resolution_clock::now();
         al_start_timer(m_timer);
         m_running = true;
 
@@ -118,149 +363,319 @@ namespace render
                 m_redraw_pending = true;
                 break;
             case ALLEGRO_EVENT_DISPLAY_CLOSE:
+            {
                 m_running = false;
-                wui::shutdown();
+                closeWui();
+                closeSpareWui();
+
+                // the last window to close takes the WUI system down with it
+                bool othersRunning = false;
+                for (auto r : getRenderers())
+                {
+                    othersRunning |= r != this && r->isRunning();
+                }
+
+                if (!othersRunning)
+                {
+                    wui::shutdown();
+                }
+                break;
+            }
+            case ALLEGRO_EVENT_DISPLAY_SWITCH_IN:
+                m_focused_renderer = this;
+                break;
+            case ALLEGRO_EVENT_DISPLAY_SWITCH_OUT:
                 break;
             case ALLEGRO_EVENT_DISPLAY_RESIZE:
             {
                 spdlog::info("Renderer resize event received: {}x{}", event.display.width, event.display.height);
-                this->m_l_osr_buffer_lock.lock();
-                al_destroy_bitmap(this->m_osr_buffer);
 
                 this->width = event.display.width;
                 this->height = event.display.height;
 
-                al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ARGB_8888);
-                this->m_osr_buffer = al_create_bitmap(this->width, this->height);
-                assert(this->m_osr_buffer != nullptr && "Failed to create OSR buffer resize");
-
-                auto locked_region = al_lock_bitmap(this->m_osr_buffer, ALLEGRO_PIXEL_FORMAT_ARGB_8888, ALLEGRO_LOCK_WRITEONLY);
-                memset(locked_region->data, 0, this->width * this->height * 4);
-                al_unlock_bitmap(this->m_osr_buffer);
+                m_l_renderables.lock();
+                m_grid.resize(this->width, this->height);
+                m_l_renderables.unlock();
 
-                if (wui::offscreenTabReady(this->wui_tab_id) == wui::WUI_OK)
+                for (auto &layer : m_layers)
                 {
-                    spdlog::info("Sending resize event to WUI");
-                    WUI_ERROR_CHECK(wui::resizeUi(this->wui_tab_id, this->width, this->height));
+                    layer->applyPending(width, height, true);
                 }
 
                 al_acknowledge_resize(m_display);
-
-                this->m_l_osr_buffer_lock.unlock();
             }
 
             break;
             default:
-                spdlog::warn("Renderer Unsupported event received: {}", event.type);
+                WUI_LOG_RATE_LIMITED(spdlog::level::warn, 1000, "Renderer Unsupported event received: {}", event.type);
                 break;
             }
 
             // Check if we need to redraw
             if (m_redraw_pending && al_is_event_queue_empty(m_event_queue))
             {
-                // Clear the screen
-                al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+                // phase timings for the HUD, a handful of clock reads per frame
+                FrameTimings timings;
+                auto phase_start = std::chrono::steady_clock::now();
+                const auto frame_start = phase_start;
+                auto phase_end = [&phase_start]()
+                {
+                    const auto now = std::chrono::steady_clock::now();
+                    const double ms = std::chrono::duration<double, std::milli>(now - phase_start).count();
+                    phase_start = now;
+                    return ms;
+                };
+
+                // Clear the screen, the rasterizer clears every tile itself
+                if (!m_soft_raster)
+                {
+                    al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+                }
 
                 // Redraw
 
-                static double delta_s = 0;
+                double delta_s = 0;
                 // Get delta between redraws to know how much time passed between last redraw
                 // Reason: Very simple way to decouple rendering FPS from game logic FPS/speed
                 // Will cause problems with collision logic on low FPS / performance
                 {
-                    static auto last_delta_time_point = std::chrono::high_resolution_clock::now();
                     auto end = std::chrono::high_resolution_clock::now();
-                    delta_s = std::chrono::duration<double, std::milli>(end - last_delta_time_point).count() / 1000; // why is chrono like this -.-
-                    last_delta_time_point = end;
+                    delta_s = std::chrono::duration<double, std::milli>(end - m_last_frame_time).count() / 1000; // why is chrono like this -.-
+                    m_last_frame_time = end;
                 }
 
-                cJSON *ballInfoObject = cJSON_CreateObject();
-
-                // create a map with ball id as key and position as value
-
-                m_l_renderables.lock();
-                for (auto &renderable : m_renderables)
+                // Take the new UI frames first so the opacity masks the scene is culled against match what is drawn on top
+                // every layer at its own rate, a capped layer keeps showing its last frame
                 {
-                    // spdlog::info("Rendering ball with id: {}", renderable->getId());
-                    renderable->render(width,
-                                       height, delta_s);
-
-                    auto thisBallInfo = cJSON_CreateObject();
-
-                    auto pos = renderable->getPosition();
+                    WUI_ALLOC_SCOPE("render.ui_upload");
+                    const auto now = std::chrono::steady_clock::now();
+                    for (auto &layer : m_layers)
+                    {
+                        layer->applyPending(width, height, false);
+                        if (!layer->update(now))
+                        {
+                            m_ui_frames_dropped_metric.inc();
+                        }
+                        timings.ui_copied_bytes += layer->getCopiedBytes();
+                        timings.ui_uploaded_bytes += layer->getUploadedBytes();
+                    }
+                }
+                timings.ui_ms = phase_end();
 
-                    cJSON_AddNumberToObject(thisBallInfo, "x", pos.x);
-                    cJSON_AddNumberToObject(thisBallInfo, "y", pos.y);
+                // nothing is serialized while the page is still busy with earlier messages
+                cJSON *ballInfoObject = nullptr;
+                if (uiReadyForInfo())
+                {
+                    WUI_ALLOC_SCOPE("render.serialize");
+                    ballInfoObject = cJSON_CreateObject();
+                }
 
-                    auto d = dynamic_cast<objects::Ball *>(renderable.get());
+                // create a map with ball id as key and position as value
 
-                    if (d != nullptr)
-                    {
-                        auto col = d->getColor();
-                        unsigned char hex[3];
-                        al_unmap_rgb(col, &hex[0], &hex[1], &hex[2]);
+                m_l_renderables.lock();
 
-                        const char *hexString = fmt::format("#{:02x}{:02x}{:02x}", hex[0], hex[1], hex[2]).c_str();
+                // simulation step, spread over the job workers, one pool (object type) after the other
+                // the chunk holds as many objects as fit the cache budget, the scene's energy is summed on the way
+                // (in chunk order with --deterministic, so it is the same run to run)
+                double energy = 0;
 
-                        cJSON_AddStringToObject(thisBallInfo, "colorHex", hexString);
-                    }
+                // room for the per chunk partials of the largest pool, grows (allocates) only here, outside the scope
+                size_t max_chunks = 0;
+                m_scene.forEachPool([&](auto &pool)
+                                    {
+                                        using object_t = std::remove_pointer_t<std::decay_t<decltype(pool[0])>>;
+                                        max_chunks = std::max(max_chunks, jobs::chunkCount(0, pool.size(), jobs::cacheChunk(sizeof(object_t)))); });
+                m_energy_partials.reserve(max_chunks);
 
-                    cJSON_AddItemToObject(ballInfoObject, std::to_string(renderable->getId()).c_str(), thisBallInfo);
+                {
+                    WUI_ALLOC_FREE_SCOPE("render.simulate");
+                    m_scene.forEachPool([&](auto &pool)
+                                        {
+                                            using object_t = std::remove_pointer_t<std::decay_t<decltype(pool[0])>>;
+                                            energy += jobs::parallel_reduce(
+                                                0, pool.size(), jobs::cacheChunk(sizeof(object_t)), 0.0,
+                                                [&](size_t begin, size_t end)
+                                                {
+                                                    WUI_ALLOC_FREE_SCOPE("render.simulate");
+                                                    double chunk_energy = 0;
+                                                    for (size_t i = begin; i < end; i++)
+                                                    {
+                                                        pool[i]->update(width, height, delta_s);
+                                                        chunk_energy += pool[i]->getKineticEnergy();
+                                                    }
+                                                    return chunk_energy;
+                                                },
+                                                [](double a, double b)
+                                                { return a + b; },
+                                                m_energy_partials); });
+                }
+                timings.simulate_ms = phase_end();
+
+                // statically dispatched per type, obj is the concrete object type
+                size_t culled = 0;
+                m_scene.forEach([&](auto &obj)
+                                {
+                                    const rectf bounds = obj.getBounds();
+                                    {
+                                        WUI_ALLOC_SCOPE("render.grid");
+                                        m_grid.update(obj.getHandle(), bounds);
+                                    }
+
+                                    // fully behind opaque UI, still simulated and reported but not drawn
+                                    const bool covered = std::any_of(m_layers.begin(), m_layers.end(), [&](const std::unique_ptr<UiLayer> &layer)
+                                                                     { return layer->isRectOpaque(bounds); });
+                                    if (covered)
+                                    {
+                                        culled++;
+                                    }
+                                    else if (m_soft_raster)
+                                    {
+                                        WUI_ALLOC_SCOPE("render.draw");
+                                        obj.rasterize(m_rasterizer);
+                                    }
+                                    else
+                                    {
+                                        WUI_ALLOC_SCOPE("render.draw");
+                                        obj.draw();
+                                    }
+
+                                    if (ballInfoObject == nullptr)
+                                    {
+                                        return;
+                                    }
+
+                                    WUI_ALLOC_SCOPE("render.serialize");
+                                    auto thisObjectInfo = cJSON_CreateObject();
+                                    obj.serialize(thisObjectInfo);
+                                    cJSON_AddItemToObject(ballInfoObject, std::to_string(obj.getId()).c_str(), thisObjectInfo); });
+                m_culled_objects = culled;
+
+                for (auto handle : m_selection)
+                {
+                    m_scene.visit(handle, [](auto &obj)
+                                  {
+                                      const rectf bounds = obj.getBounds();
+                                      const vec2f center = (bounds.min + bounds.max) * 0.5f;
+                                      al_draw_circle(center.x, center.y, std::max(bounds.width(), bounds.height()) * 0.5f + 2, al_map_rgb(255, 255, 255), 2); });
                 }
 
-                static bool sentZeroBalls = false;
+                timings.draw_ms = phase_end();
 
-                if (m_renderables.size() > 0 || sentZeroBalls == false)
+                const size_t object_count = m_scene.size();
+                if (ballInfoObject != nullptr && (object_count > 0 || m_sent_zero_balls == false))
                 {
-                    if (m_renderables.size() == 0)
+                    if (object_count == 0)
                     {
-                        sentZeroBalls = true;
+                        m_sent_zero_balls = true;
                     }
                     else
                     {
 
-                        sentZeroBalls = false;
+                        m_sent_zero_balls = false;
                     }
 
                     m_l_renderables.unlock();
 
-                    if (wui::sendEvent(this->wui_tab_id, "BallInfo", ballInfoObject) == wui::WUI_ERR_BINDINGS_NO_LISTENER_IN_DOM)
+                    WUI_ALLOC_SCOPE("render.send");
+                    const uint64_t seq = m_info_sent + 1;
+                    auto message = cJSON_CreateObject();
+                    cJSON_AddNumberToObject(message, "seq", seq);
+                    cJSON_AddNumberToObject(message, "skipped", m_info_skipped);
+                    cJSON_AddItemToObject(message, "balls", ballInfoObject);
+
+                    m_info_sent = seq;
+                    m_ui_events_sent_metric.inc();
+                    if (wui::sendEvent(m_main_layer->getTabId(), "BallInfo", message) == wui::WUI_ERR_BINDINGS_NO_LISTENER_IN_DOM)
                     {
                         // this would also return "ID UNKNOWN" in that case (most likely between restarts)
                         // this can happen if during runtime the UI gets stopped and restarted
-                        spdlog::warn("No listener registered for BallInfo event");
+                        WUI_LOG_RATE_LIMITED(spdlog::level::warn, 1000, "No listener registered for BallInfo event");
+
+                        // never arrived, nothing to wait for
+                        m_info_acked = seq;
                     }
                 }
                 else
                 {
                     m_l_renderables.unlock();
+
+                    if (ballInfoObject != nullptr)
+                    {
+                        cJSON_Delete(ballInfoObject);
+                    }
                 }
+                timings.send_ms = phase_end();
 
-                // draw OSR buffer over the screen,
-                if (this->m_l_osr_buffer_lock.try_lock())
+                // draw the OSR buffers over the screen bottom layer first, only the tiles that are not fully transparent
                 {
-                    // al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
-
-                    // copy over bitmap
-                    auto locked_region = al_lock_bitmap(m_osr_buffer, ALLEGRO_PIXEL_FORMAT_ARGB_8888, ALLEGRO_LOCK_WRITEONLY);
-
-                    if (this->wui_rgba_bitmap != nullptr)
+                    WUI_ALLOC_SCOPE("render.present");
+                    if (m_soft_raster)
                     {
-
-                        memcpy(locked_region->data, wui_rgba_bitmap, width * height * 4);
+                        // objects and UI layers in one pass over the target, tile by tile on the job workers
+                        // selections are drawn before this and would be overwritten, but headless renderers take no input
+                        auto locked_region = al_lock_bitmap(m_headless_target, ALLEGRO_PIXEL_FORMAT_ARGB_8888, ALLEGRO_LOCK_WRITEONLY);
+                        if (locked_region != nullptr)
+                        {
+                            m_rasterizer.render((uint8_t *)locked_region->data, locked_region->pitch, m_layers);
+                            al_unlock_bitmap(m_headless_target);
+                        }
+                        else
+                        {
+                            WUI_LOG_RATE_LIMITED(spdlog::level::err, 1000, "[Renderer {}] could not lock the headless target", m_index);
+                            m_rasterizer.resize(width, height); // drop this frame's circles
+                        }
                     }
                     else
                     {
-                        memset(locked_region->data, 0, width * height * 4);
+                        for (auto &layer : m_layers)
+                        {
+                            layer->draw();
+                        }
+                    }
+                    m_hud.draw(8, 8);
+                    if (!m_headless)
+                    {
+                        al_flip_display();
                     }
-                    al_unlock_bitmap(m_osr_buffer);
+                }
+                m_redraw_pending = false;
 
-                    this->m_l_osr_buffer_lock.unlock();
-                    al_draw_bitmap(m_osr_buffer, 0, 0, 0);
+                timings.present_ms = phase_end();
+                timings.total_ms = std::chrono::duration<double, std::milli>(phase_start - frame_start).count();
+                timings.objects = object_count;
+                timings.culled = culled;
+                timings.ui_events_in_flight = getUiEventsInFlight();
+                m_hud.record(timings);
+
+                if (m_capture_timings)
+                {
+                    m_l_captured_timings.lock();
+                    m_captured_timings.push_back(timings);
+                    m_l_captured_timings.unlock();
                 }
 
-                al_flip_display();
-                m_redraw_pending = false;
+                m_frames_metric.inc();
+                m_frame_time_metric.observe(timings.total_ms / 1000);
+                m_objects_metric.add((int64_t)object_count - (int64_t)m_reported_objects);
+                m_reported_objects = object_count;
+                m_energy_metric.add((int64_t)energy - m_reported_energy);
+                m_reported_energy = (int64_t)energy;
+
+                m_frame_allocations.frameEnd(m_index);
+
+                if (!m_first_ui_frame)
+                {
+                    // a page may be ready and still draw nothing visible, its first frame after that counts too
+                    const bool visible_ui = std::any_of(m_layers.begin(), m_layers.end(), [](const std::unique_ptr<UiLayer> &layer)
+                                                        { return layer->hasVisibleTiles(); });
+                    const bool tabs_ready = !m_layers.empty() && std::all_of(m_layers.begin(), m_layers.end(), [](const std::unique_ptr<UiLayer> &layer)
+                                                                            { return layer->isTabReady(); });
+                    if (visible_ui || tabs_ready)
+                    {
+                        m_first_ui_frame = true;
+                        startup::firstFrame(m_index, visible_ui);
+                    }
+                }
             }
         }
 
@@ -274,86 +689,754 @@ namespace render
         return m_display;
     }
 
+    bool Renderer::isRunning() const
+    {
+        return m_running;
+    }
+
+    bool Renderer::isHeadless() const
+    {
+        return m_headless;
+    }
+
+    size_t Renderer::getIndex() const
+    {
+        return m_index;
+    }
+
+    wui::wui_tab_id_t Renderer::getWuiTabId() const
+    {
+        return m_main_layer->getTabId();
+    }
+
     void Renderer::shutdown()
     {
-        spdlog::info("[Renderer] shutdown called");
+        spdlog::info("[Renderer {}] shutdown called", m_index);
 
         m_running = false;
 
-        spdlog::info("[Renderer] shutdown complete");
+        spdlog::info("[Renderer {}] shutdown complete", m_index);
+    }
+
+    template <typename T>
+    void Renderer::insertObject(T *obj)
+    {
+        m_grid.update(obj->getHandle(), obj->getBounds());
+        m_id_index.insert(obj->getId(), obj->getHandle());
     }
 
-    int Renderer::handleDeleteObject(const cJSON *load, cJSON *retval, std::string &exc)
+    bool Renderer::eraseObject(objects::Handle handle)
+    {
+        int id = -1;
+        if (!m_scene.visit(handle, [&](auto &obj)
+                           { id = obj.getId(); }))
+        {
+            return false;
+        }
+
+        m_id_index.erase(id);
+        m_grid.remove(handle);
+        return m_scene.destroy(handle);
+    }
+
+    size_t Renderer::eraseAllObjects()
+    {
+        const size_t count = m_scene.size();
+        m_scene.clear();
+        m_grid.clear();
+        m_selection.clear();
+        m_id_index.clear();
+        return count;
+    }
+
+    const Renderer::Command Renderer::COMMANDS[] = {
+        {"DeleteBall", &Renderer::applyDeleteBall},
+        {"DeleteBalls", &Renderer::applyDeleteBalls},
+        {"SpawnBalls", &Renderer::applySpawnBalls},
+        {"ClearAll", &Renderer::applyClearAll},
+    };
+
+    int Renderer::handleCommand(const Command &command, const cJSON *load, cJSON *retval, std::string &exc)
+    {
+        m_ui_commands_metric.inc();
+
+        m_l_renderables.lock();
+        const int ret = (this->*command.apply)(load, retval, exc);
+        m_l_renderables.unlock();
+
+        if (ret != 0)
+        {
+            spdlog::error("[Renderer {}] {}: {}", m_index, command.name, exc);
+        }
+        return ret;
+    }
+
+    int Renderer::handleBatch(const cJSON *load, cJSON *retval, std::string &exc)
+    {
+        auto commands = cJSON_GetObjectItem(load, "commands");
+        if (commands == nullptr || !cJSON_IsArray(commands))
+        {
+            exc = "Batch: commands array not found";
+            spdlog::error("[Renderer {}] {}", m_index, exc);
+            return -1;
+        }
+
+        // one result per command, in order; a failing command does not stop the ones after it
+        auto results = cJSON_CreateArray();
+        size_t failed = 0;
+
+        m_l_renderables.lock();
+        const cJSON *entry = nullptr;
+        cJSON_ArrayForEach(entry, commands)
+        {
+            auto result = cJSON_CreateObject();
+            cJSON_AddItemToArray(results, result);
+
+            auto name = cJSON_GetObjectItem(entry, "command");
+            const Command *command = nullptr;
+            if (name != nullptr && cJSON_IsString(name))
+            {
+                for (const auto &c : COMMANDS)
+                {
+                    if (strcmp(c.name, name->valuestring) == 0)
+                    {
+                        command = &c;
+                        break;
+                    }
+                }
+            }
+
+            std::string error;
+            if (command == nullptr)
+            {
+                error = "unknown command";
+            }
+            else
+            {
+                (this->*command->apply)(cJSON_GetObjectItem(entry, "payload"), result, error);
+            }
+
+            if (!error.empty())
+            {
+                cJSON_AddStringToObject(result, "error", error.c_str());
+                failed++;
+            }
+        }
+        m_l_renderables.unlock();
+
+        m_ui_commands_metric.inc(cJSON_GetArraySize(commands));
+
+        SPDLOG_DEBUG("[Renderer {}] Batch: {} commands, {} failed", m_index, cJSON_GetArraySize(commands), failed);
+
+        cJSON_AddItemToObject(retval, "results", results);
+        cJSON_AddNumberToObject(retval, "failed", failed);
+        return 0;
+    }
+
+    int Renderer::applyDeleteBall(const cJSON *load, cJSON *result, std::string &exc)
     {
         auto id = cJSON_GetObjectItem(load, "id");
-        if (id == nullptr)
+        if (id == nullptr || !cJSON_IsNumber(id))
         {
-            spdlog::error("DeleteBall: id not found");
+            exc = "id not found";
             return -1;
         }
 
-        auto idInt = id->valueint;
+        SPDLOG_DEBUG("DeleteBall: id: {}", id->valueint);
 
-        spdlog::info("DeleteBall: id: {}", idInt);
+        const objects::Handle *handle = m_id_index.find(id->valueint);
+        const bool deleted = handle != nullptr && eraseObject(*handle);
+        cJSON_AddBoolToObject(result, "deleted", deleted);
+        return 0;
+    }
 
-        m_l_renderables.lock();
+    int Renderer::applyDeleteBalls(const cJSON *load, cJSON *result, std::string &exc)
+    {
+        auto ids = cJSON_GetObjectItem(load, "ids");
+        if (ids == nullptr || !cJSON_IsArray(ids))
+        {
+            exc = "ids array not found";
+            return -1;
+        }
 
-        for (auto it = m_renderables.begin(); it != m_renderables.end(); ++it)
+        // unknown ids are skipped, the UI may still show objects that died a frame ago
+        size_t deleted = 0;
+        const cJSON *id = nullptr;
+        cJSON_ArrayForEach(id, ids)
         {
-            if ((*it)->getId() == idInt)
+            const objects::Handle *handle = cJSON_IsNumber(id) ? m_id_index.find(id->valueint) : nullptr;
+            if (handle != nullptr)
             {
-                spdlog::info("DeleteBall: found ball with id: {}", idInt);
-                m_renderables.erase(it);
-                break;
+                deleted += eraseObject(*handle);
+            }
+        }
+
+        SPDLOG_DEBUG("DeleteBalls: {} of {} deleted", deleted, cJSON_GetArraySize(ids));
+        cJSON_AddNumberToObject(result, "deleted", deleted);
+        return 0;
+    }
+
+    int Renderer::applySpawnBalls(const cJSON *load, cJSON *result, std::string &exc)
+    {
+        auto balls = cJSON_GetObjectItem(load, "balls");
+        if (balls == nullptr || !cJSON_IsArray(balls))
+        {
+            exc = "balls array not found";
+            return -1;
+        }
+
+        const int count = cJSON_GetArraySize(balls);
+        m_scene.pool<objects::Ball>().reserve(m_scene.pool<objects::Ball>().size() + count);
+
+        auto ids = cJSON_CreateArray();
+        const cJSON *entry = nullptr;
+        cJSON_ArrayForEach(entry, balls)
+        {
+            auto x = cJSON_GetObjectItem(entry, "x");
+            auto y = cJSON_GetObjectItem(entry, "y");
+            if (x == nullptr || y == nullptr || !cJSON_IsNumber(x) || !cJSON_IsNumber(y))
+            {
+                continue;
             }
+
+            auto ball = m_scene.create<objects::Ball>(x->valueint, y->valueint);
+            insertObject(ball);
+            cJSON_AddItemToArray(ids, cJSON_CreateNumber(ball->getId()));
+        }
+
+        SPDLOG_DEBUG("SpawnBalls: {} of {} spawned", cJSON_GetArraySize(ids), count);
+        cJSON_AddItemToObject(result, "ids", ids);
+        return 0;
+    }
+
+    int Renderer::applyClearAll(const cJSON *, cJSON *result, std::string &)
+    {
+        const size_t count = eraseAllObjects();
+        spdlog::info("[Renderer {}] ClearAll: cleared {} objects", m_index, count);
+        cJSON_AddNumberToObject(result, "deleted", count);
+        return 0;
+    }
+
+    objects::Handle Renderer::spawnBall(int x, int y)
+    {
+        m_l_renderables.lock();
+        auto ball = m_scene.create<objects::Ball>(x, y);
+        insertObject(ball);
+        m_l_renderables.unlock();
+        return ball->getHandle();
+    }
+
+    void Renderer::clearObjects()
+    {
+        m_l_renderables.lock();
+        const size_t count = eraseAllObjects();
+        m_l_renderables.unlock();
+
+        spdlog::info("[Renderer {}] cleared {} objects", m_index, count);
+    }
+
+    void Renderer::reserveObjects(size_t count)
+    {
+        m_l_renderables.lock();
+        m_scene.reserve(count);
+        m_id_index.reserve(count);
+        reserveGrid();
+        m_l_renderables.unlock();
+    }
+
+    void Renderer::reserveGrid()
+    {
+        // any slot a pool may hand out, pools round up to whole chunks and reuse freed slots
+        size_t slots = 0;
+        m_scene.forEachPool([&](auto &pool)
+                            { slots = std::max(slots, pool.capacity()); });
+        m_grid.reserve(slots);
+    }
+
+    size_t Renderer::getObjectCount()
+    {
+        m_l_renderables.lock();
+        const size_t count = m_scene.size();
+        m_l_renderables.unlock();
+        return count;
+    }
+
+    objects::Handle Renderer::pickObject(vec2f point)
+    {
+        objects::Handle ret;
+
+        m_l_renderables.lock();
+        m_query_scratch.clear();
+        m_grid.queryPoint(point, m_query_scratch);
+
+        // the grid only knows boxes, narrow down to the actual shape, hits are kept in place at the front
+        size_t hits = 0;
+        m_pick_points.clear();
+        for (auto handle : m_query_scratch)
+        {
+            m_scene.visit(handle, [&](auto &obj)
+                          {
+                              if (obj.hitTest(point))
+                              {
+                                  m_query_scratch[hits++] = handle;
+                                  m_pick_points.push_back(obj.getPosition());
+                              } });
         }
 
+        // the closest center wins where objects overlap
+        const size_t best = WUI::batch::nearest(m_pick_points, point);
+        if (best != SIZE_MAX)
+        {
+            ret = m_query_scratch[best];
+        }
+        m_l_renderables.unlock();
+
+        return ret;
+    }
+
+    std::vector<objects::Handle> Renderer::nearestObjects(vec2f point, size_t k)
+    {
+        std::vector<objects::Handle> ret;
+        m_l_renderables.lock();
+        m_grid.nearestK(point, k, ret);
         m_l_renderables.unlock();
+        return ret;
+    }
+
+    bool Renderer::destroyObject(objects::Handle handle)
+    {
+        m_l_renderables.lock();
+        const bool ret = eraseObject(handle);
+        m_l_renderables.unlock();
+        return ret;
+    }
+
+    size_t Renderer::selectObjects(const rectf &area)
+    {
+        m_l_renderables.lock();
+        m_selection.clear();
+        m_grid.queryRect(area, m_selection);
+        const size_t count = m_selection.size();
+        m_l_renderables.unlock();
+
+        spdlog::info("[Renderer {}] selected {} objects", m_index, count);
+        return count;
+    }
+
+    void Renderer::deleteSelected()
+    {
+        m_l_renderables.lock();
+        size_t count = 0;
+        for (auto handle : m_selection)
+        {
+            count += eraseObject(handle);
+        }
+        m_selection.clear();
+        m_l_renderables.unlock();
+
+        spdlog::info("[Renderer {}] deleted {} selected objects", m_index, count);
+    }
+
+    bool Renderer::saveSnapshot(const std::string &path)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+
+        std::vector<objects::BallRecord> records;
+        m_l_renderables.lock();
+        auto &balls = m_scene.pool<objects::Ball>();
+        records.reserve(balls.size());
+        for (auto ball : balls)
+        {
+            records.push_back(ball->toRecord());
+        }
+        m_l_renderables.unlock();
+
+        // file I/O outside the lock, the render loop keeps going
+        if (!objects::writeSnapshot(path, records.data(), records.size(), width, height))
+        {
+            return false;
+        }
+
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        spdlog::info("[Renderer {}] saved {} objects to {} in {:.1f} ms", m_index, records.size(), path, ms);
+        return true;
+    }
+
+    bool Renderer::loadSnapshot(const std::string &path)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+
+        objects::SnapshotFile file;
+        if (!file.open(path))
+        {
+            return false;
+        }
+        const size_t count = file.getCount();
+        const auto mapped = std::chrono::steady_clock::now();
+
+        m_l_renderables.lock();
+        eraseAllObjects();
+
+        auto &balls = m_scene.pool<objects::Ball>();
+        balls.reserve(count);
+        m_id_index.reserve(count);
+        reserveGrid();
+
+        // records are copied straight out of the mapping, the pool does not allocate per object
+        for (size_t i = 0; i < count; i++)
+        {
+            auto ball = balls.create(file.getRecord(i));
+            insertObject(ball);
+        }
+        m_l_renderables.unlock();
+
+        const auto end = std::chrono::steady_clock::now();
+        const double map_ms = std::chrono::duration<double, std::milli>(mapped - begin).count();
+        const double fill_ms = std::chrono::duration<double, std::milli>(end - mapped).count();
+        spdlog::info("[Renderer {}] loaded {} objects from {} in {:.1f} ms (map {:.1f} ms, fill {:.1f} ms, {:.1f} M objects/s)",
+                     m_index, count, path, map_ms + fill_ms, map_ms, fill_ms, fill_ms > 0 ? count / fill_ms / 1000 : 0.0);
+
+        const auto &header = file.getHeader();
+        if (header.scene_width != width || header.scene_height != height)
+        {
+            spdlog::info("[Renderer {}] snapshot was taken at {}x{}, objects outside the window bounce back in", m_index, header.scene_width, header.scene_height);
+        }
+        return true;
+    }
+
+    void Renderer::setUiScale(float scale)
+    {
+        m_main_layer->setScale(scale);
+    }
+
+    void Renderer::setUiViewport(const recti &viewport)
+    {
+        m_main_layer->setViewport(viewport);
+    }
+
+    recti Renderer::getUiViewport() const
+    {
+        return m_main_layer->getViewport();
+    }
+
+    float Renderer::getUiScale() const
+    {
+        return m_main_layer->getScale();
+    }
+
+    std::vector<UiLayer *> Renderer::getUiLayersTopDown() const
+    {
+        std::vector<UiLayer *> ret;
+        for (auto it = m_layers.rbegin(); it != m_layers.rend(); it++)
+        {
+            ret.push_back(it->get());
+        }
+        return ret;
+    }
+
+    UiLayer *Renderer::getUiLayerAt(vec2i window_pos) const
+    {
+        for (auto it = m_layers.rbegin(); it != m_layers.rend(); it++)
+        {
+            if ((*it)->contains(window_pos) && !(*it)->isTransparentAt(window_pos))
+            {
+                return it->get();
+            }
+        }
+        return nullptr;
+    }
+
+    UiLayer *Renderer::getFocusedUiLayer() const
+    {
+        return m_focused_layer;
+    }
+
+    void Renderer::focusUiLayer(UiLayer *layer)
+    {
+        m_focused_layer = layer;
+    }
+
+    void Renderer::togglePerfHud()
+    {
+        m_hud.toggle();
+    }
+
+    void Renderer::setFrameTimingCapture(bool enabled)
+    {
+        m_capture_timings = enabled;
+        if (!enabled)
+        {
+            m_l_captured_timings.lock();
+            m_captured_timings.clear();
+            m_l_captured_timings.unlock();
+        }
+    }
+
+    std::vector<FrameTimings> Renderer::takeFrameTimings()
+    {
+        std::vector<FrameTimings> ret;
+        m_l_captured_timings.lock();
+        ret.swap(m_captured_timings);
+        m_l_captured_timings.unlock();
+        return ret;
+    }
+
+    size_t Renderer::getCulledObjectCount() const
+    {
+        return m_culled_objects;
+    }
+
+    bool Renderer::uiReadyForInfo()
+    {
+        const size_t max_in_flight = m_max_ui_events_in_flight;
+        if (max_in_flight == 0 || getUiEventsInFlight() < max_in_flight)
+        {
+            m_info_stalled = false;
+            return true;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (!m_info_stalled)
+        {
+            m_info_stalled = true;
+            m_info_stalled_since = now;
+        }
+        else if (now - m_info_stalled_since > UI_ACK_TIMEOUT)
+        {
+            WUI_LOG_RATE_LIMITED(spdlog::level::warn, 5000, "[Renderer {}] BallInfo not acknowledged for {} ms, resyncing", m_index, UI_ACK_TIMEOUT.count());
+            m_info_acked = m_info_sent.load();
+            m_info_stalled = false;
+            return true;
+        }
+
+        // the next message sent carries the full state anyway, so skipping merges the updates in between
+        m_info_skipped++;
+        m_ui_events_skipped_metric.inc();
+        return false;
+    }
+
+    int Renderer::handleInfoAck(const cJSON *load, cJSON *, std::string &exc)
+    {
+        auto seq = cJSON_GetObjectItem(load, "seq");
+        if (seq == nullptr || !cJSON_IsNumber(seq))
+        {
+            exc = "BallInfoAck: seq not found";
+            spdlog::error("[Renderer {}] {}", m_index, exc);
+            return -1;
+        }
+
+        // acks may overtake each other, only ever move forward
+        const uint64_t acked = (uint64_t)seq->valuedouble;
+        uint64_t current = m_info_acked;
+        while (current < acked && acked <= m_info_sent && !m_info_acked.compare_exchange_weak(current, acked))
+        {
+        }
+        return 0;
+    }
+
+    int Renderer::handleTextInputMode(UiLayer &layer, const cJSON *load, cJSON *, std::string &exc)
+    {
+        auto active = cJSON_GetObjectItem(load, "active");
+        if (active == nullptr || !cJSON_IsBool(active))
+        {
+            exc = "TextInputMode: active not found";
+            spdlog::error("[Renderer {}] {}", m_index, exc);
+            return -1;
+        }
 
+        layer.setTextInputActive(cJSON_IsTrue(active));
+        SPDLOG_DEBUG("[Renderer {}] layer {}: text input {}", m_index, layer.getName(), layer.isTextInputActive() ? "active" : "inactive");
+        return 0;
+    }
+
+    int Renderer::handleLayerRole(const UiLayer &layer, const cJSON *, cJSON *retval, std::string &)
+    {
+        cJSON_AddStringToObject(retval, "name", layer.getName().c_str());
+        cJSON_AddNumberToObject(retval, "z", layer.getZ());
         return 0;
     }
 
-    void Renderer::start()
+    size_t Renderer::getUiEventsInFlight() const
+    {
+        const uint64_t acked = m_info_acked;
+        const uint64_t sent = m_info_sent;
+        return sent > acked ? sent - acked : 0;
+    }
+
+    size_t Renderer::getSkippedUiUpdates() const
+    {
+        return m_info_skipped;
+    }
+
+    objects::PoolStats Renderer::getPoolStats()
+    {
+        m_l_renderables.lock();
+        const objects::PoolStats stats = m_scene.getStats();
+        m_l_renderables.unlock();
+        return stats;
+    }
+
+    void Renderer::start(bool open_wui)
     {
         if (m_render_thread.joinable())
         {
-            spdlog::warn("[Renderer] already running");
+            spdlog::warn("[Renderer {}] already running", m_index);
             return;
         }
 
-        spdlog::info("[Renderer] starting");
+        spdlog::info("[Renderer {}] starting", m_index);
 
+        m_open_wui_on_start = open_wui;
         m_render_thread = std::thread(&Renderer::renderLoop, this);
     }
 
     void Renderer::restartWui()
     {
-        spdlog::info("[Renderer] restarting WUI");
-        if (this->wui_tab_id == 0)
+        const auto requested_at = std::chrono::steady_clock::now();
+        spdlog::info("[Renderer {}] restarting WUI", m_index);
+        for (auto &layer_ptr : m_layers)
+        {
+            UiLayer *layer = layer_ptr.get();
+
+            // a spare already loaded the page and asked for its role, it only misses the listeners for the running page
+            wui::wui_tab_id_t tab_id = layer->takeSpareTab();
+            const bool from_spare = tab_id != 0;
+            if (!from_spare)
+            {
+                tab_id = layer->createTab();
+                if (tab_id == 0)
+                {
+                    spdlog::info("[Renderer {}] wui of layer {} already running", m_index, layer->getName());
+                    continue;
+                }
+
+                WUI_ERROR_CHECK(
+                    wui::registerEventListener(tab_id, "LayerRole", [this, layer](const cJSON *load, cJSON *retval, std::string &exc) -> int
+                                               { return this->handleLayerRole(*layer, load, retval, exc); }))
+            }
+
+            registerUiListeners(layer, tab_id);
+
+            if (layer == m_main_layer)
+            {
+                // a fresh page has nothing in flight
+                m_info_acked = m_info_sent.load();
+            }
+
+            layer->publishTab(tab_id, requested_at, from_spare);
+        }
+
+        prewarmWui();
+    }
+
+    void Renderer::registerUiListeners(UiLayer *layer, wui::wui_tab_id_t tab_id)
+    {
+        // any layer may send commands, BallInfo only goes to the main one
+        for (const auto &command : COMMANDS)
         {
-            WUI_ERROR_CHECK(wui::createOffscreenTab(this->wui_tab_id, &wui_rgba_bitmap, width, height, true));
             WUI_ERROR_CHECK(
-                wui::registerEventListener(this->wui_tab_id, "DeleteBall", [](const cJSON *load, cJSON *retval, std::string &exc) -> int
-                                           { return renderer.handleDeleteObject(load, retval, exc); }))
+                wui::registerEventListener(tab_id, command.name, [this, &command](const cJSON *load, cJSON *retval, std::string &exc) -> int
+                                           { return this->handleCommand(command, load, retval, exc); }))
         }
-        else
+        WUI_ERROR_CHECK(
+            wui::registerEventListener(tab_id, "Batch", [this](const cJSON *load, cJSON *retval, std::string &exc) -> int
+                                       { return this->handleBatch(load, retval, exc); }))
+        WUI_ERROR_CHECK(
+            wui::registerEventListener(tab_id, "TextInputMode", [this, layer](const cJSON *load, cJSON *retval, std::string &exc) -> int
+                                       { return this->handleTextInputMode(*layer, load, retval, exc); }))
+
+        if (layer == m_main_layer)
+        {
+            WUI_ERROR_CHECK(
+                wui::registerEventListener(tab_id, "BallInfoAck", [this](const cJSON *load, cJSON *retval, std::string &exc) -> int
+                                           { return this->handleInfoAck(load, retval, exc); }))
+        }
+    }
+
+    void Renderer::unregisterUiListeners(const UiLayer *layer, wui::wui_tab_id_t tab_id)
+    {
+        // not strictly necessary, deleting the tab deletes the router that holds these callbacks
+        for (const auto &command : COMMANDS)
+        {
+            WUI_ERROR_CHECK(wui::unregisterEventListener(tab_id, command.name));
+        }
+        WUI_ERROR_CHECK(wui::unregisterEventListener(tab_id, "Batch"));
+        WUI_ERROR_CHECK(wui::unregisterEventListener(tab_id, "TextInputMode"));
+        if (layer == m_main_layer)
         {
-            spdlog::info("[Renderer]wui already running");
+            WUI_ERROR_CHECK(wui::unregisterEventListener(tab_id, "BallInfoAck"));
+        }
+    }
+
+    void Renderer::prewarmWui()
+    {
+        if (!m_prewarm_ui)
+        {
+            return;
+        }
+
+        for (auto &layer_ptr : m_layers)
+        {
+            UiLayer *layer = layer_ptr.get();
+            const wui::wui_tab_id_t tab_id = layer->createSpareTab();
+            if (tab_id == 0)
+            {
+                continue;
+            }
+
+            // the page asks for its role on load, commands and the rest wait until it takes over
+            WUI_ERROR_CHECK(
+                wui::registerEventListener(tab_id, "LayerRole", [this, layer](const cJSON *load, cJSON *retval, std::string &exc) -> int
+                                           { return this->handleLayerRole(*layer, load, retval, exc); }))
+            spdlog::info("[Renderer {}] prewarming spare tab {} (layer {})", m_index, tab_id, layer->getName());
+        }
+    }
+
+    void Renderer::closeWui()
+    {
+        for (auto &layer : m_layers)
+        {
+            const wui::wui_tab_id_t tab_id = layer->releaseTab();
+            if (tab_id == 0)
+            {
+                continue;
+            }
+
+            unregisterUiListeners(layer.get(), tab_id);
+            WUI_ERROR_CHECK(wui::unregisterEventListener(tab_id, "LayerRole"));
+            WUI_ERROR_CHECK(wui::closeOffscreenTab(tab_id));
+            spdlog::info("[Renderer {}] Destroyed tab {} (layer {})", m_index, tab_id, layer->getName());
+        }
+    }
+
+    void Renderer::closeSpareWui()
+    {
+        for (auto &layer : m_layers)
+        {
+            const wui::wui_tab_id_t tab_id = layer->releaseSpareTab();
+            if (tab_id == 0)
+            {
+                continue;
+            }
+
+            WUI_ERROR_CHECK(wui::unregisterEventListener(tab_id, "LayerRole"));
+            WUI_ERROR_CHECK(wui::closeOffscreenTab(tab_id));
+            spdlog::info("[Renderer {}] Destroyed spare tab {} (layer {})", m_index, tab_id, layer->getName());
         }
     }
 
     void Renderer::waitUntilEnd()
     {
-        spdlog::info("[Renderer] waiting until end");
+        spdlog::info("[Renderer {}] waiting until end", m_index);
         if (m_render_thread.joinable())
         {
             m_render_thread.join();
         }
         else
         {
-            spdlog::warn("[Renderer] not running");
+            spdlog::warn("[Renderer {}] not running", m_index);
         }
-        spdlog::info("[Renderer] wait complete");
+        spdlog::info("[Renderer {}] wait complete", m_index);
     }
 
 }
\ No newline at end of file
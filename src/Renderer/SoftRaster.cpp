@@ -0,0 +1,262 @@
+#include "Renderer/SoftRaster.hpp"
+#include "Renderer/UiLayer.hpp"
+#include "Jobs/JobSystem.hpp"
+#include "Profiling/AllocTracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace render
+{
+    namespace
+    {
+        inline uint8_t toByte(float channel)
+        {
+            return (uint8_t)(std::clamp(channel, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+
+        // every channel * k / 256, k in [0, 256]
+        inline uint32_t scalePixel(uint32_t color, uint32_t k)
+        {
+            const uint32_t rb = (((color & 0x00FF00FF) * k) >> 8) & 0x00FF00FF;
+            const uint32_t ag = (((color >> 8) & 0x00FF00FF) * k) & 0xFF00FF00;
+            return rb | ag;
+        }
+
+        // Fill count pixels with a single premultiplied color, opaque colors are plain stores
+        inline void fillSpan(uint32_t *dst, size_t count, uint32_t color)
+        {
+            size_t i = 0;
+            const uint32_t alpha = color >> 24;
+
+            if (alpha == 0xFF)
+            {
+#if defined(__SSE2__)
+                const __m128i c = _mm_set1_epi32((int)color);
+                for (; i + 4 <= count; i += 4)
+                {
+                    _mm_storeu_si128((__m128i *)(dst + i), c);
+                }
+#endif
+                for (; i < count; i++)
+                {
+                    dst[i] = color;
+                }
+                return;
+            }
+
+#if defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i c = _mm_set1_epi32((int)color);
+            const __m128i k = _mm_set1_epi16((short)(256 - alpha));
+            for (; i + 4 <= count; i += 4)
+            {
+                const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+                const __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), k), 8);
+                const __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), k), 8);
+                _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epu8(_mm_packus_epi16(lo, hi), c));
+            }
+#endif
+            for (; i < count; i++)
+            {
+                dst[i] = SoftRasterizer::blendPixel(dst[i], color);
+            }
+        }
+    }
+
+    void SoftRasterizer::blendSpan(uint32_t *dst, const uint32_t *src, size_t count)
+    {
+        size_t i = 0;
+
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i opaque = _mm_set1_epi32(0xFF);
+        const __m128i k_max = _mm_set1_epi16(256);
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+
+            // UI frames are mostly fully transparent or fully opaque, both skip the multiplies
+            const __m128i alpha = _mm_srli_epi32(s, 24);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xFFFF)
+            {
+                continue;
+            }
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, opaque)) == 0xFFFF)
+            {
+                _mm_storeu_si128((__m128i *)(dst + i), s);
+                continue;
+            }
+
+            // 256 - alpha broadcast over the 4 channels of each pixel, 2 pixels per register
+            const __m128i s_lo = _mm_unpacklo_epi8(s, zero);
+            const __m128i s_hi = _mm_unpackhi_epi8(s, zero);
+            const __m128i k_lo = _mm_sub_epi16(k_max, _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+            const __m128i k_hi = _mm_sub_epi16(k_max, _mm_shufflehi_epi16(_mm_shufflelo_epi16(s_hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+
+            const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            const __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), k_lo), 8);
+            const __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), k_hi), 8);
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epu8(_mm_packus_epi16(lo, hi), s));
+        }
+#endif
+
+        for (; i < count; i++)
+        {
+            dst[i] = blendPixel(dst[i], src[i]);
+        }
+    }
+
+    void SoftRasterizer::resize(size_t width, size_t height)
+    {
+        m_width = width;
+        m_height = height;
+        m_tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+        m_tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+        m_circles.clear();
+        m_bins.clear();
+        m_bins.resize(m_tiles_x * m_tiles_y);
+    }
+
+    void SoftRasterizer::addCircle(vec2f center, float radius, ALLEGRO_COLOR color)
+    {
+        if (radius <= 0 || m_bins.empty())
+        {
+            return;
+        }
+
+        // pixels the anti-aliased edge may touch
+        const float reach = radius + 0.5f;
+        const int x0 = std::max(0, (int)std::floor(center.x - reach));
+        const int y0 = std::max(0, (int)std::floor(center.y - reach));
+        const int x1 = std::min((int)m_width, (int)std::ceil(center.x + reach));
+        const int y1 = std::min((int)m_height, (int)std::ceil(center.y + reach));
+        if (x0 >= x1 || y0 >= y1)
+        {
+            return;
+        }
+
+        const uint32_t index = m_circles.size();
+        const uint32_t argb = (uint32_t)toByte(color.a) << 24 | (uint32_t)toByte(color.r) << 16 | (uint32_t)toByte(color.g) << 8 | toByte(color.b);
+        m_circles.push_back({center.x, center.y, radius, argb});
+
+        for (size_t tile_y = y0 / TILE_SIZE; tile_y <= (y1 - 1) / TILE_SIZE; tile_y++)
+        {
+            for (size_t tile_x = x0 / TILE_SIZE; tile_x <= (x1 - 1) / TILE_SIZE; tile_x++)
+            {
+                m_bins[tile_y * m_tiles_x + tile_x].push_back(index);
+            }
+        }
+    }
+
+    void SoftRasterizer::drawCircle(const Circle &circle, uint8_t *dst, ptrdiff_t pitch, const recti &tile) const
+    {
+        // coverage of a pixel is r + 0.5 - (distance of its center), so it is full within r - 0.5 and gone beyond r + 0.5
+        const float r_in = std::max(0.0f, circle.radius - 0.5f);
+        const float r_out = circle.radius + 0.5f;
+        const float r_in2 = r_in * r_in;
+        const float r_out2 = r_out * r_out;
+
+        const int y0 = std::max(tile.min.y, (int)std::floor(circle.y - r_out));
+        const int y1 = std::min(tile.max.y, (int)std::ceil(circle.y + r_out));
+
+        for (int y = y0; y < y1; y++)
+        {
+            const float dy = y + 0.5f - circle.y;
+            const float dy2 = dy * dy;
+            if (dy2 >= r_out2)
+            {
+                continue;
+            }
+
+            const float outer = std::sqrt(r_out2 - dy2);
+            const int xa = std::max(tile.min.x, (int)std::floor(circle.x - outer));
+            const int xb = std::min(tile.max.x, (int)std::ceil(circle.x + outer));
+            if (xa >= xb)
+            {
+                continue;
+            }
+
+            // pixel centers within inner of the center column are fully covered
+            int ia = xa;
+            int ib = xa;
+            if (dy2 < r_in2)
+            {
+                const float inner = std::sqrt(r_in2 - dy2);
+                ia = std::clamp((int)std::ceil(circle.x - inner - 0.5f), xa, xb);
+                ib = std::clamp((int)std::floor(circle.x + inner - 0.5f) + 1, ia, xb);
+            }
+
+            uint32_t *row = (uint32_t *)(dst + (ptrdiff_t)y * pitch);
+
+            auto edge = [&](int x)
+            {
+                const float dx = x + 0.5f - circle.x;
+                const float coverage = circle.radius + 0.5f - std::sqrt(dx * dx + dy2);
+                if (coverage <= 0)
+                {
+                    return;
+                }
+                const uint32_t k = coverage >= 1 ? 256 : (uint32_t)(coverage * 256);
+                row[x] = blendPixel(row[x], scalePixel(circle.color, k));
+            };
+
+            for (int x = xa; x < ia; x++)
+            {
+                edge(x);
+            }
+            fillSpan(row + ia, ib - ia, circle.color);
+            for (int x = ib; x < xb; x++)
+            {
+                edge(x);
+            }
+        }
+    }
+
+    void SoftRasterizer::render(uint8_t *dst, ptrdiff_t pitch, const std::vector<std::unique_ptr<UiLayer>> &layers)
+    {
+        // one tile per job, tiles differ a lot in cost and idle workers steal the expensive ones' neighbours
+        jobs::parallel_for(0, m_bins.size(), 1, [&](size_t begin, size_t end)
+                           {
+                               WUI_ALLOC_FREE_SCOPE("render.raster");
+                               for (size_t t = begin; t < end; t++)
+                               {
+                                   const int x0 = (t % m_tiles_x) * TILE_SIZE;
+                                   const int y0 = (t / m_tiles_x) * TILE_SIZE;
+                                   const recti tile(vec2i(x0, y0), vec2i(std::min<int>(m_width, x0 + TILE_SIZE), std::min<int>(m_height, y0 + TILE_SIZE)));
+
+                                   for (int y = tile.min.y; y < tile.max.y; y++)
+                                   {
+                                       memset(dst + (ptrdiff_t)y * pitch + tile.min.x * 4, 0, tile.width() * 4);
+                                   }
+
+                                   for (const uint32_t index : m_bins[t])
+                                   {
+                                       drawCircle(m_circles[index], dst, pitch, tile);
+                                   }
+
+                                   for (const auto &layer : layers)
+                                   {
+                                       layer->blendInto(dst, pitch, tile);
+                                   }
+                               } });
+
+        m_drawn = m_circles.size();
+        m_circles.clear();
+        for (auto &bin : m_bins)
+        {
+            bin.clear();
+        }
+    }
+
+    size_t SoftRasterizer::getCircleCount() const
+    {
+        return m_drawn;
+    }
+}
@@ -0,0 +1,512 @@
+#include "Renderer/UiCompositor.hpp"
+#include "Renderer/SoftRaster.hpp"
+#include "Jobs/JobSystem.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace render
+{
+    namespace
+    {
+        const uint32_t ALPHA_MASK = 0xFF000000;
+
+        // Copy count pixels from src to dst while folding all pixels into alpha_and / alpha_or
+        // and noting whether any pixel differs from what dst held before.
+        // CEF paints BGRA bytes, which on little endian is exactly ALLEGRO_PIXEL_FORMAT_ARGB_8888 (0xAARRGGBB),
+        // so the format conversion is a plain copy and the scan rides along for free.
+        inline void scanRow(const uint32_t *src, uint32_t *dst, size_t count, uint32_t &alpha_and, uint32_t &alpha_or, bool &changed)
+        {
+            size_t i = 0;
+
+#if defined(__SSE2__)
+            __m128i v_and = _mm_set1_epi32(-1);
+            __m128i v_or = _mm_setzero_si128();
+            int equal = 0xFFFF;
+
+            for (; i + 4 <= count; i += 4)
+            {
+                const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+                const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+                equal &= _mm_movemask_epi8(_mm_cmpeq_epi32(s, d));
+                v_and = _mm_and_si128(v_and, s);
+                v_or = _mm_or_si128(v_or, s);
+
+                _mm_storeu_si128((__m128i *)(dst + i), s);
+            }
+
+            alignas(16) uint32_t lanes_and[4];
+            alignas(16) uint32_t lanes_or[4];
+            _mm_store_si128((__m128i *)lanes_and, v_and);
+            _mm_store_si128((__m128i *)lanes_or, v_or);
+
+            alpha_and &= lanes_and[0] & lanes_and[1] & lanes_and[2] & lanes_and[3];
+            alpha_or |= lanes_or[0] | lanes_or[1] | lanes_or[2] | lanes_or[3];
+            changed |= equal != 0xFFFF;
+#endif
+
+            for (; i < count; i++)
+            {
+                const uint32_t p = src[i];
+                changed |= p != dst[i];
+                alpha_and &= p;
+                alpha_or |= p;
+                dst[i] = p;
+            }
+        }
+    }
+
+    UiCompositor::~UiCompositor()
+    {
+        resize(0, 0);
+    }
+
+    void UiCompositor::resize(size_t width, size_t height)
+    {
+        if (m_bitmap != nullptr)
+        {
+            al_destroy_bitmap(m_bitmap);
+            m_bitmap = nullptr;
+        }
+
+        m_width = width;
+        m_height = height;
+        m_tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+        m_tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+        m_shadow.assign(width * height, 0);
+        m_tiles.assign(m_tiles_x * m_tiles_y, TileState::TRANSPARENT);
+        m_dirty.assign(m_tiles_x * m_tiles_y, 0);
+        m_hit_cells.assign(m_tiles_x * m_tiles_y, 0);
+        m_uploaded_bytes = 0;
+        rebuildOpacityMask();
+        publishHitMask();
+
+        if (width == 0 || height == 0)
+        {
+            return;
+        }
+
+        // Video bitmap: uploads go straight to the texture and drawing never takes the software path
+        // Headless renderers have no display to own a texture, everything stays in memory there
+        const int old_flags = al_get_new_bitmap_flags();
+        const int old_format = al_get_new_bitmap_format();
+        const int storage = al_get_current_display() != nullptr ? ALLEGRO_VIDEO_BITMAP : ALLEGRO_MEMORY_BITMAP;
+        al_set_new_bitmap_flags(storage | ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR);
+        al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ARGB_8888);
+
+        m_bitmap = al_create_bitmap(width, height);
+
+        al_set_new_bitmap_flags(old_flags);
+        al_set_new_bitmap_format(old_format);
+
+        assert(m_bitmap != nullptr && "Failed to create UI compositor bitmap");
+    }
+
+    bool UiCompositor::scanTileRow(const uint32_t *src, size_t tile_y, bool &pixels_changed)
+    {
+        bool state_changed = false;
+
+        const size_t y0 = tile_y * TILE_SIZE;
+        const size_t y1 = std::min(m_height, y0 + TILE_SIZE);
+
+        for (size_t tile_x = 0; tile_x < m_tiles_x; tile_x++)
+        {
+            const size_t x0 = tile_x * TILE_SIZE;
+            const size_t w = std::min(m_width, x0 + TILE_SIZE) - x0;
+
+            uint32_t alpha_and = 0xFFFFFFFF;
+            uint32_t alpha_or = 0;
+            bool changed = false;
+
+            for (size_t y = y0; y < y1; y++)
+            {
+                const size_t offset = y * m_width + x0;
+                scanRow(src + offset, m_shadow.data() + offset, w, alpha_and, alpha_or, changed);
+            }
+
+            TileState state = TileState::MIXED;
+            if ((alpha_or & ALPHA_MASK) == 0)
+            {
+                state = TileState::TRANSPARENT;
+            }
+            else if ((alpha_and & ALPHA_MASK) == ALPHA_MASK)
+            {
+                state = TileState::OPAQUE;
+            }
+
+            const size_t index = tile_y * m_tiles_x + tile_x;
+            const TileState previous = m_tiles[index];
+            state_changed |= previous != state;
+            m_tiles[index] = state;
+
+            // A transparent tile is never drawn, but scaled drawing filters across the edge of its neighbours,
+            // so it is uploaded once when it turns transparent and then left alone
+            m_dirty[index] = changed && (state != TileState::TRANSPARENT || previous != TileState::TRANSPARENT);
+
+            if (changed)
+            {
+                m_hit_cells[index] = buildHitCells(tile_x, tile_y, state);
+                pixels_changed = true;
+            }
+        }
+
+        return state_changed;
+    }
+
+    void UiCompositor::update(const void *bgra)
+    {
+        m_uploaded_bytes = 0;
+        m_copied_bytes = 0;
+
+        if (m_bitmap == nullptr)
+        {
+            return;
+        }
+
+        if (bgra == nullptr)
+        {
+            std::fill(m_shadow.begin(), m_shadow.end(), 0);
+            std::fill(m_tiles.begin(), m_tiles.end(), TileState::TRANSPARENT);
+            std::fill(m_hit_cells.begin(), m_hit_cells.end(), 0);
+            rebuildOpacityMask();
+            publishHitMask();
+            return;
+        }
+
+        const uint32_t *src = static_cast<const uint32_t *>(bgra);
+        m_copied_bytes = m_width * m_height * 4;
+
+        // tile rows touch disjoint parts of the shadow buffer, scan them in parallel
+        std::atomic<bool> states_changed(false);
+        std::atomic<bool> pixels_changed(false);
+        jobs::parallel_for(0, m_tiles_y, 1, [&](size_t begin, size_t end)
+                           {
+                               bool row_pixels_changed = false;
+                               for (size_t tile_y = begin; tile_y < end; tile_y++)
+                               {
+                                   if (scanTileRow(src, tile_y, row_pixels_changed))
+                                   {
+                                       states_changed = true;
+                                   }
+                               }
+                               if (row_pixels_changed)
+                               {
+                                   pixels_changed = true;
+                               } });
+
+        if (states_changed)
+        {
+            rebuildOpacityMask();
+        }
+
+        if (pixels_changed)
+        {
+            publishHitMask();
+        }
+
+        uploadDirtyTiles();
+    }
+
+    void UiCompositor::rebuildOpacityMask()
+    {
+        const size_t stride = m_tiles_x + 1;
+        m_opaque_sat.assign(stride * (m_tiles_y + 1), 0);
+
+        for (size_t tile_y = 0; tile_y < m_tiles_y; tile_y++)
+        {
+            uint32_t row_sum = 0;
+            for (size_t tile_x = 0; tile_x < m_tiles_x; tile_x++)
+            {
+                row_sum += m_tiles[tile_y * m_tiles_x + tile_x] == TileState::OPAQUE;
+                m_opaque_sat[(tile_y + 1) * stride + tile_x + 1] = m_opaque_sat[tile_y * stride + tile_x + 1] + row_sum;
+            }
+        }
+    }
+
+    uint64_t UiCompositor::buildHitCells(size_t tile_x, size_t tile_y, TileState state) const
+    {
+        if (state == TileState::TRANSPARENT)
+        {
+            return 0;
+        }
+        if (state == TileState::OPAQUE)
+        {
+            return ~0ull; // cells past the frame edge are never asked for
+        }
+
+        const size_t x0 = tile_x * TILE_SIZE;
+        const size_t y0 = tile_y * TILE_SIZE;
+        const size_t x1 = std::min(m_width, x0 + TILE_SIZE);
+        const size_t y1 = std::min(m_height, y0 + TILE_SIZE);
+
+        uint64_t cells = 0;
+        for (size_t y = y0; y < y1; y++)
+        {
+            const uint32_t *row = m_shadow.data() + y * m_width;
+            const size_t cell_row = (y - y0) / HIT_CELL * 8;
+            for (size_t x = x0; x < x1; x++)
+            {
+                if (row[x] & ALPHA_MASK)
+                {
+                    cells |= 1ull << (cell_row + (x - x0) / HIT_CELL);
+                }
+            }
+        }
+        return cells;
+    }
+
+    void UiCompositor::publishHitMask()
+    {
+        // a few KB, same size every frame so the copy does not allocate
+        m_l_hit_mask.lock();
+        m_hit_mask = m_hit_cells;
+        m_hit_width = m_width;
+        m_hit_height = m_height;
+        m_hit_tiles_x = m_tiles_x;
+        m_l_hit_mask.unlock();
+    }
+
+    bool UiCompositor::isTransparentAt(vec2f pos) const
+    {
+        m_l_hit_mask.lock();
+        bool transparent = true;
+        if (pos.x >= 0 && pos.y >= 0 && pos.x < m_hit_width && pos.y < m_hit_height)
+        {
+            const size_t x = (size_t)pos.x;
+            const size_t y = (size_t)pos.y;
+            const uint64_t cells = m_hit_mask[(y / TILE_SIZE) * m_hit_tiles_x + x / TILE_SIZE];
+            const size_t bit = (y % TILE_SIZE) / HIT_CELL * 8 + (x % TILE_SIZE) / HIT_CELL;
+            transparent = !(cells & (1ull << bit));
+        }
+        m_l_hit_mask.unlock();
+        return transparent;
+    }
+
+    bool UiCompositor::isRectOpaque(const rectf &area) const
+    {
+        if (m_tiles_x == 0 || area.empty() || area.min.x < 0 || area.min.y < 0 || area.max.x > m_width || area.max.y > m_height)
+        {
+            return false; // anything reaching past the UI is visible at least there
+        }
+
+        const size_t tx0 = (size_t)area.min.x / TILE_SIZE;
+        const size_t ty0 = (size_t)area.min.y / TILE_SIZE;
+        const size_t tx1 = std::min(m_tiles_x, (size_t)std::ceil(area.max.x / TILE_SIZE)); // exclusive
+        const size_t ty1 = std::min(m_tiles_y, (size_t)std::ceil(area.max.y / TILE_SIZE));
+
+        const size_t stride = m_tiles_x + 1;
+        const uint32_t opaque = m_opaque_sat[ty1 * stride + tx1] - m_opaque_sat[ty0 * stride + tx1] - m_opaque_sat[ty1 * stride + tx0] + m_opaque_sat[ty0 * stride + tx0];
+
+        return opaque == (tx1 - tx0) * (ty1 - ty0);
+    }
+
+    void UiCompositor::uploadDirtyTiles()
+    {
+        // One lock per tile row covering the span of dirty tiles, keeps the texture upload calls low
+        for (size_t tile_y = 0; tile_y < m_tiles_y; tile_y++)
+        {
+            const uint8_t *row = m_dirty.data() + tile_y * m_tiles_x;
+
+            size_t first = 0;
+            while (first < m_tiles_x && !row[first])
+            {
+                first++;
+            }
+
+            if (first == m_tiles_x)
+            {
+                continue;
+            }
+
+            size_t last = m_tiles_x - 1;
+            while (!row[last])
+            {
+                last--;
+            }
+
+            const size_t x0 = first * TILE_SIZE;
+            const size_t x1 = std::min(m_width, (last + 1) * TILE_SIZE);
+            const size_t y0 = tile_y * TILE_SIZE;
+            const size_t y1 = std::min(m_height, y0 + TILE_SIZE);
+
+            auto locked_region = al_lock_bitmap_region(m_bitmap, x0, y0, x1 - x0, y1 - y0, ALLEGRO_PIXEL_FORMAT_ARGB_8888, ALLEGRO_LOCK_WRITEONLY);
+            if (locked_region == nullptr)
+            {
+                spdlog::error("[UiCompositor] could not lock bitmap region");
+                return;
+            }
+
+            // pitch may be negative (OpenGL bitmaps are locked bottom up)
+            for (size_t y = y0; y < y1; y++)
+            {
+                uint8_t *dst = (uint8_t *)locked_region->data + (ptrdiff_t)(y - y0) * locked_region->pitch;
+                memcpy(dst, m_shadow.data() + y * m_width + x0, (x1 - x0) * 4);
+            }
+
+            al_unlock_bitmap(m_bitmap);
+
+            m_uploaded_bytes += (x1 - x0) * (y1 - y0) * 4;
+        }
+    }
+
+    void UiCompositor::draw(float x, float y, float scale)
+    {
+        if (m_bitmap == nullptr)
+        {
+            return;
+        }
+
+        al_hold_bitmap_drawing(true);
+
+        // Merge horizontal runs of visible tiles into a single quad
+        for (size_t tile_y = 0; tile_y < m_tiles_y; tile_y++)
+        {
+            const TileState *row = m_tiles.data() + tile_y * m_tiles_x;
+
+            size_t tile_x = 0;
+            while (tile_x < m_tiles_x)
+            {
+                if (row[tile_x] == TileState::TRANSPARENT)
+                {
+                    tile_x++;
+                    continue;
+                }
+
+                const size_t run_start = tile_x;
+                while (tile_x < m_tiles_x && row[tile_x] != TileState::TRANSPARENT)
+                {
+                    tile_x++;
+                }
+
+                const float sx = run_start * TILE_SIZE;
+                const float sy = tile_y * TILE_SIZE;
+                const float sw = std::min(m_width, tile_x * TILE_SIZE) - sx;
+                const float sh = std::min(m_height, (tile_y + 1) * TILE_SIZE) - sy;
+
+                if (scale == 1.0f)
+                {
+                    al_draw_bitmap_region(m_bitmap, sx, sy, sw, sh, x + sx, y + sy, 0);
+                }
+                else
+                {
+                    al_draw_scaled_bitmap(m_bitmap, sx, sy, sw, sh, x + sx * scale, y + sy * scale, sw * scale, sh * scale, 0);
+                }
+            }
+        }
+
+        al_hold_bitmap_drawing(false);
+    }
+
+    void UiCompositor::blendInto(uint8_t *dst, ptrdiff_t pitch, const recti &area, vec2i origin, float scale) const
+    {
+        if (m_width == 0 || m_height == 0)
+        {
+            return;
+        }
+
+        // window pixels the frame covers, clipped to the area
+        const int x0 = std::max(area.min.x, origin.x);
+        const int y0 = std::max(area.min.y, origin.y);
+        const int x1 = std::min(area.max.x, origin.x + (int)std::ceil(m_width * scale));
+        const int y1 = std::min(area.max.y, origin.y + (int)std::ceil(m_height * scale));
+        if (x0 >= x1 || y0 >= y1)
+        {
+            return;
+        }
+
+        if (scale == 1.0f)
+        {
+            for (int y = y0; y < y1; y++)
+            {
+                const size_t src_y = y - origin.y;
+                const uint32_t *src_row = m_shadow.data() + src_y * m_width;
+                uint32_t *dst_row = (uint32_t *)(dst + (ptrdiff_t)y * pitch);
+
+                // one run per tile the row crosses
+                for (int x = x0; x < x1;)
+                {
+                    const size_t src_x = x - origin.x;
+                    const int run_end = std::min(x1, origin.x + (int)((src_x / TILE_SIZE + 1) * TILE_SIZE));
+
+                    switch (m_tiles[(src_y / TILE_SIZE) * m_tiles_x + src_x / TILE_SIZE])
+                    {
+                    case TileState::TRANSPARENT:
+                        break;
+                    case TileState::OPAQUE:
+                        memcpy(dst_row + x, src_row + src_x, (run_end - x) * 4);
+                        break;
+                    case TileState::MIXED:
+                        SoftRasterizer::blendSpan(dst_row + x, src_row + src_x, run_end - x);
+                        break;
+                    }
+                    x = run_end;
+                }
+            }
+            return;
+        }
+
+        const float inv_scale = 1.0f / scale;
+        for (int y = y0; y < y1; y++)
+        {
+            const size_t src_y = std::min(m_height - 1, (size_t)((y + 0.5f - origin.y) * inv_scale));
+            const uint32_t *src_row = m_shadow.data() + src_y * m_width;
+            const TileState *tile_row = m_tiles.data() + (src_y / TILE_SIZE) * m_tiles_x;
+            uint32_t *dst_row = (uint32_t *)(dst + (ptrdiff_t)y * pitch);
+
+            for (int x = x0; x < x1; x++)
+            {
+                const size_t src_x = std::min(m_width - 1, (size_t)((x + 0.5f - origin.x) * inv_scale));
+                if (tile_row[src_x / TILE_SIZE] != TileState::TRANSPARENT)
+                {
+                    dst_row[x] = SoftRasterizer::blendPixel(dst_row[x], src_row[src_x]);
+                }
+            }
+        }
+    }
+
+    bool UiCompositor::hasVisibleTiles() const
+    {
+        return std::any_of(m_tiles.begin(), m_tiles.end(), [](TileState state)
+                           { return state != TileState::TRANSPARENT; });
+    }
+
+    TileState UiCompositor::getTileState(size_t tile_x, size_t tile_y) const
+    {
+        if (tile_x >= m_tiles_x || tile_y >= m_tiles_y)
+        {
+            return TileState::TRANSPARENT;
+        }
+        return m_tiles[tile_y * m_tiles_x + tile_x];
+    }
+
+    size_t UiCompositor::getTilesX() const
+    {
+        return m_tiles_x;
+    }
+
+    size_t UiCompositor::getTilesY() const
+    {
+        return m_tiles_y;
+    }
+
+    size_t UiCompositor::getUploadedBytes() const
+    {
+        return m_uploaded_bytes;
+    }
+
+    size_t UiCompositor::getCopiedBytes() const
+    {
+        return m_copied_bytes;
+    }
+}
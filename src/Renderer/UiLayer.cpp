@@ -0,0 +1,328 @@
+#include "Renderer/UiLayer.hpp"
+#include "Renderer/Renderer.hpp"
+#include "Logging/Logging.hpp"
+#include "Profiling/Metrics.hpp"
+#include "webUi.hpp"
+#include "webUiInput.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace render
+{
+    metrics::Histogram m_ui_start_metric("wui_ui_start_seconds", "Time from (re)starting a UI layer until its tab is ready",
+                                         {0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5});
+    metrics::Counter m_ui_spare_used_metric("wui_ui_spare_tabs_used_total", "UI restarts that took over a prewarmed spare tab");
+
+    UiLayer::UiLayer(const UiLayerConfig &config, size_t window_width, size_t window_height)
+        : m_name(config.name), m_z(config.z),
+          m_frame_interval(config.max_fps > 0 ? std::chrono::nanoseconds(1000000000 / config.max_fps) : std::chrono::nanoseconds(0))
+    {
+        m_scale = std::clamp(config.scale, MIN_UI_SCALE, 1.0f);
+        m_scale_requested = m_scale.load();
+        m_viewport_requested = config.viewport;
+        resolveViewport(window_width, window_height);
+    }
+
+    const std::string &UiLayer::getName() const
+    {
+        return m_name;
+    }
+
+    int UiLayer::getZ() const
+    {
+        return m_z;
+    }
+
+    wui::wui_tab_id_t UiLayer::getTabId() const
+    {
+        return m_tab_id;
+    }
+
+    bool UiLayer::isTabReady() const
+    {
+        return m_tab_ready;
+    }
+
+    wui::wui_tab_id_t UiLayer::createTab()
+    {
+        if (m_tab_id != 0)
+        {
+            return 0;
+        }
+
+        wui::wui_tab_id_t tab_id = 0;
+        m_l_osr_buffer.lock();
+        WUI_ERROR_CHECK(wui::createOffscreenTab(tab_id, &m_rgba[m_active_slot], getSurfaceWidth(), getSurfaceHeight(), true));
+        m_l_osr_buffer.unlock();
+        return tab_id;
+    }
+
+    void UiLayer::publishTab(wui::wui_tab_id_t tab_id, std::chrono::steady_clock::time_point requested_at, bool from_spare)
+    {
+        m_text_input_active = false; // a fresh page has nothing focused
+        m_start_requested = requested_at;
+        m_start_from_spare = from_spare;
+        m_tab_ready = false;
+        m_tab_id = tab_id;
+        m_start_pending = true;
+
+        if (from_spare)
+        {
+            m_ui_spare_used_metric.inc();
+        }
+    }
+
+    wui::wui_tab_id_t UiLayer::releaseTab()
+    {
+        m_text_input_active = false;
+        m_start_pending = false;
+        m_tab_ready = false;
+        return m_tab_id.exchange(0);
+    }
+
+    wui::wui_tab_id_t UiLayer::createSpareTab()
+    {
+        if (m_spare_tab_id != 0)
+        {
+            return 0;
+        }
+
+        wui::wui_tab_id_t tab_id = 0;
+        m_l_osr_buffer.lock();
+        WUI_ERROR_CHECK(wui::createOffscreenTab(tab_id, &m_rgba[1 - m_active_slot], getSurfaceWidth(), getSurfaceHeight(), true));
+        m_spare_tab_id = tab_id;
+        m_l_osr_buffer.unlock();
+        return tab_id;
+    }
+
+    wui::wui_tab_id_t UiLayer::takeSpareTab()
+    {
+        m_l_osr_buffer.lock();
+        wui::wui_tab_id_t tab_id = 0;
+        if (m_tab_id == 0 && m_spare_tab_id != 0)
+        {
+            // the closed tab's slot is free again and takes the next spare
+            tab_id = m_spare_tab_id.exchange(0);
+            m_active_slot = 1 - m_active_slot;
+
+            // the window may have changed while it waited, the next frame resizes it before reading anything
+            m_surface_dirty = true;
+        }
+        m_l_osr_buffer.unlock();
+        return tab_id;
+    }
+
+    wui::wui_tab_id_t UiLayer::releaseSpareTab()
+    {
+        m_l_osr_buffer.lock();
+        const wui::wui_tab_id_t tab_id = m_spare_tab_id.exchange(0);
+        m_l_osr_buffer.unlock();
+        return tab_id;
+    }
+
+    void UiLayer::setScale(float scale)
+    {
+        m_scale_requested = std::clamp(scale, MIN_UI_SCALE, 1.0f);
+        m_surface_dirty = true;
+    }
+
+    float UiLayer::getScale() const
+    {
+        return m_scale;
+    }
+
+    void UiLayer::setViewport(const recti &viewport)
+    {
+        m_l_viewport.lock();
+        m_viewport_requested = viewport;
+        m_l_viewport.unlock();
+        m_surface_dirty = true;
+    }
+
+    recti UiLayer::getViewport() const
+    {
+        m_l_viewport.lock();
+        const recti ret = m_viewport;
+        m_l_viewport.unlock();
+        return ret;
+    }
+
+    void UiLayer::resolveViewport(size_t window_width, size_t window_height)
+    {
+        m_l_viewport.lock();
+        const recti &req = m_viewport_requested;
+        const int w = std::max(1, (int)window_width);
+        const int h = std::max(1, (int)window_height);
+
+        recti resolved;
+        resolved.min = {std::clamp(req.min.x, 0, w - 1), std::clamp(req.min.y, 0, h - 1)};
+        resolved.max = {req.width() > 0 ? std::clamp(req.max.x, resolved.min.x + 1, w) : w,
+                        req.height() > 0 ? std::clamp(req.max.y, resolved.min.y + 1, h) : h};
+        m_viewport = resolved;
+        m_l_viewport.unlock();
+    }
+
+    size_t UiLayer::getSurfaceWidth() const
+    {
+        return std::max<size_t>(1, (size_t)std::ceil(getViewport().width() * m_scale));
+    }
+
+    size_t UiLayer::getSurfaceHeight() const
+    {
+        return std::max<size_t>(1, (size_t)std::ceil(getViewport().height() * m_scale));
+    }
+
+    void UiLayer::applyPending(size_t window_width, size_t window_height, bool window_changed)
+    {
+        if (!m_surface_dirty.exchange(false) && !window_changed)
+        {
+            return;
+        }
+
+        m_l_osr_buffer.lock();
+        m_scale = m_scale_requested.load();
+        resolveViewport(window_width, window_height);
+        m_compositor.resize(getSurfaceWidth(), getSurfaceHeight());
+        m_last_update = {}; // the next frame is taken regardless of the cap
+
+        for (const wui::wui_tab_id_t tab_id : {m_tab_id.load(), m_spare_tab_id.load()})
+        {
+            if (tab_id != 0 && wui::offscreenTabReady(tab_id) == wui::WUI_OK)
+            {
+                WUI_ERROR_CHECK(wui::resizeUi(tab_id, getSurfaceWidth(), getSurfaceHeight()));
+            }
+        }
+        m_l_osr_buffer.unlock();
+
+        const recti viewport = getViewport();
+        spdlog::info("[UiLayer {}] viewport {}x{} at {} {}, scale {:.2f}, tab at {}x{}", m_name, viewport.width(), viewport.height(),
+                     viewport.min.x, viewport.min.y, m_scale.load(), getSurfaceWidth(), getSurfaceHeight());
+    }
+
+    bool UiLayer::update(std::chrono::steady_clock::time_point now)
+    {
+        m_updated = false;
+
+        if (m_start_pending && wui::offscreenTabReady(m_tab_id) == wui::WUI_OK)
+        {
+            m_start_pending = false;
+            m_tab_ready = true;
+            const double seconds = std::chrono::duration<double>(now - m_start_requested).count();
+            m_ui_start_metric.observe(seconds);
+            spdlog::info("[UiLayer {}] tab {} ready {:.1f} ms after the {}", m_name, m_tab_id.load(), seconds * 1000,
+                         m_start_from_spare ? "restart (prewarmed spare)" : "start");
+        }
+
+        if (m_frame_interval.count() > 0 && now - m_last_update < m_frame_interval)
+        {
+            return true; // capped, nothing missed
+        }
+
+        if (!m_l_osr_buffer.try_lock())
+        {
+            return false;
+        }
+
+        if (m_surface_dirty)
+        {
+            // a spare took over since applyPending, its buffer may not match the compositor yet
+            m_l_osr_buffer.unlock();
+            return true;
+        }
+
+        m_compositor.update(m_rgba[m_active_slot]);
+        m_l_osr_buffer.unlock();
+
+        m_last_update = now;
+        m_updated = true;
+        return true;
+    }
+
+    void UiLayer::draw()
+    {
+        // only the render thread writes the viewport
+        const vec2f origin = (vec2f)m_viewport.min;
+        m_compositor.draw(origin.x, origin.y, 1.0f / m_scale);
+    }
+
+    void UiLayer::blendInto(uint8_t *dst, ptrdiff_t pitch, const recti &area) const
+    {
+        m_compositor.blendInto(dst, pitch, area, m_viewport.min, 1.0f / m_scale);
+    }
+
+    bool UiLayer::isRectOpaque(const rectf &window_area) const
+    {
+        const vec2f origin = (vec2f)m_viewport.min;
+        const float scale = m_scale;
+        return m_compositor.isRectOpaque(rectf((window_area.min - origin) * scale, (window_area.max - origin) * scale));
+    }
+
+    bool UiLayer::hasVisibleTiles() const
+    {
+        return m_compositor.hasVisibleTiles();
+    }
+
+    size_t UiLayer::getCopiedBytes() const
+    {
+        return m_updated ? m_compositor.getCopiedBytes() : 0;
+    }
+
+    size_t UiLayer::getUploadedBytes() const
+    {
+        return m_updated ? m_compositor.getUploadedBytes() : 0;
+    }
+
+    void UiLayer::releaseSurface()
+    {
+        m_l_osr_buffer.lock();
+        m_compositor.resize(0, 0);
+        m_l_osr_buffer.unlock();
+    }
+
+    bool UiLayer::contains(vec2i window_pos) const
+    {
+        return m_tab_id != 0 && getViewport().contains(window_pos);
+    }
+
+    bool UiLayer::isTransparentAt(vec2i window_pos) const
+    {
+        const vec2f ui_pos = (vec2f)(window_pos - getViewport().min) * m_scale.load();
+        return m_compositor.isTransparentAt(ui_pos);
+    }
+
+    void UiLayer::setTextInputActive(bool active)
+    {
+        m_text_input_active = active;
+    }
+
+    bool UiLayer::isTextInputActive() const
+    {
+        return m_text_input_active;
+    }
+
+    void UiLayer::verifyTextInputMode()
+    {
+        const wui::wui_tab_id_t tab_id = m_tab_id;
+        if (tab_id == 0)
+        {
+            return;
+        }
+
+        wui::wui_text_input_mode_t mode = wui::WUI_TEXT_INPUT_MODE_ERROR;
+        WUI_ERROR_CHECK(wui::getCurrentTextInputMode(tab_id, mode));
+        if (mode == wui::WUI_TEXT_INPUT_MODE_ERROR)
+        {
+            return;
+        }
+
+        // a lost or reordered push from the page, WUI knows better
+        const bool active = mode != wui::WUI_TEXT_INPUT_MODE_NONE;
+        if (m_text_input_active.exchange(active) != active)
+        {
+            WUI_LOG_RATE_LIMITED(spdlog::level::warn, 5000, "[UiLayer {}] cached text input mode was out of date, now {}", m_name, active ? "active" : "inactive");
+        }
+    }
+}
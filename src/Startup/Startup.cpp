@@ -0,0 +1,182 @@
+#include "Startup/Startup.hpp"
+#include "Threads/Topology.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cassert>
+#include <thread>
+
+namespace startup
+{
+    // Close enough to process start, static init of this translation unit
+    const std::chrono::steady_clock::time_point m_origin = std::chrono::steady_clock::now();
+
+    struct Record
+    {
+        std::string name;
+        double begin_ms;
+        double end_ms;
+    };
+
+    std::mutex l_records;
+    std::vector<Record> m_records;
+    size_t m_expected_frames = 1;
+    size_t m_first_frames = 0;
+    bool m_timeline_logged = false;
+
+    double sinceOrigin(std::chrono::steady_clock::time_point t)
+    {
+        return std::chrono::duration<double, std::milli>(t - m_origin).count();
+    }
+
+    void record(std::string name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+    {
+        l_records.lock();
+        m_records.push_back({std::move(name), sinceOrigin(begin), sinceOrigin(end)});
+        l_records.unlock();
+    }
+
+    Phase::Phase(std::string name) : m_name(std::move(name)), m_begin(std::chrono::steady_clock::now())
+    {
+    }
+
+    Phase::~Phase()
+    {
+        record(std::move(m_name), m_begin, std::chrono::steady_clock::now());
+    }
+
+    void mark(const std::string &name)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        record(name, now, now);
+    }
+
+    void expectFirstFrames(size_t count)
+    {
+        l_records.lock();
+        m_expected_frames = count;
+        l_records.unlock();
+
+        // a window whose page never shows up would otherwise keep the timeline from ever being logged
+        std::thread([]() -> void
+                    {
+                        threads::registerCurrent(threads::Role::MAIN, "startup-timeout");
+                        std::this_thread::sleep_for(FIRST_FRAME_TIMEOUT);
+
+                        l_records.lock();
+                        const size_t arrived = m_first_frames;
+                        const size_t expected = m_expected_frames;
+                        const bool log = !m_timeline_logged;
+                        m_timeline_logged = true;
+                        l_records.unlock();
+
+                        if (log)
+                        {
+                            spdlog::warn("[Startup] only {} of {} renderers presented a UI frame within {} s", arrived, expected, FIRST_FRAME_TIMEOUT.count());
+                            logTimeline();
+                        } })
+            .detach();
+    }
+
+    void firstFrame(size_t renderer_index, bool visible_ui)
+    {
+        mark(fmt::format("renderer {} first UI frame{}", renderer_index, visible_ui ? "" : " (tabs ready, nothing visible)"));
+
+        l_records.lock();
+        const bool last = ++m_first_frames == m_expected_frames && !m_timeline_logged;
+        m_timeline_logged = m_timeline_logged || last;
+        l_records.unlock();
+
+        if (last)
+        {
+            logTimeline();
+        }
+    }
+
+    void logTimeline()
+    {
+        const size_t BAR_WIDTH = 40;
+
+        l_records.lock();
+        std::vector<Record> records = m_records;
+        l_records.unlock();
+
+        std::stable_sort(records.begin(), records.end(), [](const Record &a, const Record &b)
+                         { return a.begin_ms < b.begin_ms; });
+
+        double total_ms = 0;
+        for (auto &r : records)
+        {
+            total_ms = std::max(total_ms, r.end_ms);
+        }
+
+        spdlog::info("[Startup] timeline, {:.1f} ms until the first UI frame", total_ms);
+        for (auto &r : records)
+        {
+            // one bar per phase, scaled to the whole startup
+            std::string bar(BAR_WIDTH, ' ');
+            if (total_ms > 0)
+            {
+                const size_t from = std::min(BAR_WIDTH - 1, (size_t)(r.begin_ms / total_ms * BAR_WIDTH));
+                const size_t to = std::max(from + 1, std::min(BAR_WIDTH, (size_t)(r.end_ms / total_ms * BAR_WIDTH + 0.5)));
+                std::fill(bar.begin() + from, bar.begin() + to, r.end_ms > r.begin_ms ? '=' : '|');
+            }
+
+            spdlog::info("[Startup] |{}| {:>8.1f} {:>8.1f} ms  {}", bar, r.begin_ms, r.end_ms - r.begin_ms, r.name);
+        }
+    }
+
+    TaskGraph::task_t TaskGraph::add(std::string name, std::vector<task_t> dependencies, std::function<void()> fn)
+    {
+        assert(!m_started && "steps can not be added after start()");
+
+        for (auto dep : dependencies)
+        {
+            assert(dep < m_state->tasks.size() && "dependencies have to be added first");
+            (void)dep;
+        }
+
+        m_state->tasks.push_back({std::move(name), std::move(dependencies), std::move(fn)});
+        return m_state->tasks.size() - 1;
+    }
+
+    void TaskGraph::start()
+    {
+        m_started = true;
+
+        for (task_t index = 0; index < m_state->tasks.size(); index++)
+        {
+            // the state is shared, steps may outlive the graph object
+            std::thread([state = m_state, index]() -> void
+                        {
+                            Task &task = state->tasks[index];
+                            threads::registerCurrent(threads::Role::MAIN, "init-" + task.name);
+
+                            {
+                                std::unique_lock<std::mutex> lk(state->lock);
+                                state->changed.wait(lk, [&]()
+                                                    { return std::all_of(task.dependencies.begin(), task.dependencies.end(), [&](task_t dep)
+                                                                         { return state->tasks[dep].done; }); });
+                            }
+
+                            {
+                                Phase phase(task.name);
+                                task.fn();
+                            }
+
+                            state->lock.lock();
+                            task.done = true;
+                            state->lock.unlock();
+                            state->changed.notify_all(); })
+                .detach();
+        }
+    }
+
+    void TaskGraph::wait(task_t task)
+    {
+        std::unique_lock<std::mutex> lk(m_state->lock);
+        m_state->changed.wait(lk, [&]()
+                              { return m_state->tasks[task].done; });
+    }
+}
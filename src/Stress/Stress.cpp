@@ -0,0 +1,265 @@
+#include "Stress/Stress.hpp"
+#include "Jobs/JobSystem.hpp"
+#include "cJSON.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace stress
+{
+    namespace
+    {
+        const std::chrono::milliseconds START_TIMEOUT(30000);
+
+        struct Step
+        {
+            size_t count = 0;
+            std::vector<render::FrameTimings> frames;
+            double expected_frames = 0;
+            double frame_ms_median = 0;
+            double frame_ms_percentile = 0;
+            bool sustained = false;
+        };
+
+        // nearest rank
+        double percentileOf(std::vector<double> values, double p)
+        {
+            if (values.empty())
+            {
+                return 0;
+            }
+            std::sort(values.begin(), values.end());
+            const size_t rank = (size_t)std::ceil(p * values.size());
+            return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+        }
+
+        // same seed every run, so two machines are compared on the same scene
+        void setCount(render::Renderer *renderer, size_t count, std::mt19937 &rng)
+        {
+            renderer->clearObjects();
+            renderer->reserveObjects(count);
+
+            std::uniform_int_distribution<int> x(0, render::BASE_WIDTH - 1);
+            std::uniform_int_distribution<int> y(0, render::BASE_HEIGHT - 1);
+            for (size_t i = 0; i < count; i++)
+            {
+                renderer->spawnBall(x(rng), y(rng));
+            }
+        }
+
+        Step measure(render::Renderer *renderer, size_t count, const Config &config, std::chrono::milliseconds duration, std::mt19937 &rng)
+        {
+            Step step;
+            step.count = count;
+
+            setCount(renderer, count, rng);
+            std::this_thread::sleep_for(config.settle);
+            renderer->takeFrameTimings();
+
+            const auto begin = std::chrono::steady_clock::now();
+            std::this_thread::sleep_for(duration);
+            step.frames = renderer->takeFrameTimings();
+            const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+            std::vector<double> frame_ms;
+            frame_ms.reserve(step.frames.size());
+            for (auto &frame : step.frames)
+            {
+                frame_ms.push_back(frame.total_ms);
+            }
+            step.frame_ms_median = percentileOf(frame_ms, 0.5);
+            step.frame_ms_percentile = percentileOf(frame_ms, config.percentile);
+
+            // frames that took too long merge timer ticks, so a low frame count fails the step as well
+            step.expected_frames = elapsed_s * config.fps;
+            const double budget_ms = 1000.0 / config.fps;
+            step.sustained = !step.frames.empty() &&
+                             step.frame_ms_percentile <= budget_ms * (1 - config.margin) &&
+                             step.frames.size() >= step.expected_frames * (1 - config.margin);
+
+            spdlog::info("[Stress] {:>8} objects: {:>4} frames (expected {:.0f}), median {:.2f} ms, p{:.0f} {:.2f} ms -> {}",
+                         count, step.frames.size(), step.expected_frames, step.frame_ms_median,
+                         config.percentile * 100, step.frame_ms_percentile, step.sustained ? "holds" : "misses");
+            return step;
+        }
+
+        cJSON *stepToJson(const Step &step)
+        {
+            auto json = cJSON_CreateObject();
+            cJSON_AddNumberToObject(json, "objects", step.count);
+            cJSON_AddNumberToObject(json, "frames", step.frames.size());
+            cJSON_AddNumberToObject(json, "expected_frames", std::round(step.expected_frames));
+            cJSON_AddNumberToObject(json, "frame_ms_median", step.frame_ms_median);
+            cJSON_AddNumberToObject(json, "frame_ms_percentile", step.frame_ms_percentile);
+            cJSON_AddBoolToObject(json, "sustained", step.sustained);
+            return json;
+        }
+
+        // averages per phase over the step's frames, maxima where an average hides the problem
+        cJSON *phasesToJson(const Step &step)
+        {
+            render::FrameTimings sum;
+            double max_frame_ms = 0;
+            size_t max_in_flight = 0;
+            for (auto &frame : step.frames)
+            {
+                sum.total_ms += frame.total_ms;
+                sum.ui_ms += frame.ui_ms;
+                sum.simulate_ms += frame.simulate_ms;
+                sum.draw_ms += frame.draw_ms;
+                sum.send_ms += frame.send_ms;
+                sum.present_ms += frame.present_ms;
+                sum.culled += frame.culled;
+                sum.ui_copied_bytes += frame.ui_copied_bytes;
+                sum.ui_uploaded_bytes += frame.ui_uploaded_bytes;
+                max_frame_ms = std::max(max_frame_ms, frame.total_ms);
+                max_in_flight = std::max(max_in_flight, frame.ui_events_in_flight);
+            }
+            const double n = std::max<size_t>(1, step.frames.size());
+
+            auto json = stepToJson(step);
+            cJSON_AddNumberToObject(json, "frame_ms_avg", sum.total_ms / n);
+            cJSON_AddNumberToObject(json, "frame_ms_max", max_frame_ms);
+
+            auto phases = cJSON_CreateObject();
+            cJSON_AddNumberToObject(phases, "ui", sum.ui_ms / n);
+            cJSON_AddNumberToObject(phases, "simulate", sum.simulate_ms / n);
+            cJSON_AddNumberToObject(phases, "draw", sum.draw_ms / n);
+            cJSON_AddNumberToObject(phases, "send", sum.send_ms / n);
+            cJSON_AddNumberToObject(phases, "present", sum.present_ms / n);
+            cJSON_AddItemToObject(json, "phase_ms_avg", phases);
+
+            cJSON_AddNumberToObject(json, "culled_avg", sum.culled / n);
+            cJSON_AddNumberToObject(json, "ui_copied_bytes_avg", sum.ui_copied_bytes / n);
+            cJSON_AddNumberToObject(json, "ui_uploaded_bytes_avg", sum.ui_uploaded_bytes / n);
+            cJSON_AddNumberToObject(json, "ui_events_in_flight_max", max_in_flight);
+            return json;
+        }
+
+        bool writeReport(const std::string &path, cJSON *report)
+        {
+            char *text = cJSON_Print(report);
+            if (text == nullptr)
+            {
+                spdlog::error("[Stress] could not serialize the report");
+                return false;
+            }
+
+            FILE *file = fopen(path.c_str(), "w");
+            bool ok = file != nullptr;
+            if (ok)
+            {
+                ok = fputs(text, file) >= 0;
+                ok = (fclose(file) == 0) && ok;
+            }
+            free(text);
+
+            if (!ok)
+            {
+                spdlog::error("[Stress] could not write {}: {}", path, strerror(errno));
+            }
+            return ok;
+        }
+    }
+
+    bool run(render::Renderer *renderer, const Config &config)
+    {
+        const auto wait_start = std::chrono::steady_clock::now();
+        while (!renderer->isRunning())
+        {
+            if (std::chrono::steady_clock::now() - wait_start > START_TIMEOUT)
+            {
+                spdlog::error("[Stress] renderer {} did not start", renderer->getIndex());
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+
+        spdlog::info("[Stress] renderer {} ({}): searching the highest object count at {:.0f} fps, p{:.0f} frame time within {:.0f}% of the budget",
+                     renderer->getIndex(), renderer->isHeadless() ? "headless" : "window", config.fps, config.percentile * 100, (1 - config.margin) * 100);
+
+        std::mt19937 rng(0x5eed);
+        renderer->setFrameTimingCapture(true);
+
+        std::vector<Step> steps;
+        size_t held = 0;   // highest count that held
+        size_t missed = 0; // lowest count that missed, 0 while the ramp is still climbing
+
+        // ramp: double until a step misses
+        for (size_t count = std::max<size_t>(1, config.start_count); missed == 0;)
+        {
+            steps.push_back(measure(renderer, count, config, config.measure, rng));
+            if (!steps.back().sustained)
+            {
+                missed = count;
+                break;
+            }
+
+            held = count;
+            if (count >= config.max_count)
+            {
+                spdlog::warn("[Stress] reached the limit of {} objects without missing the budget", config.max_count);
+                break;
+            }
+            count = std::min(count * 2, config.max_count);
+        }
+
+        // binary search within (held, missed)
+        while (missed != 0 && missed - held > std::max<size_t>(1, (size_t)(held * config.resolution)))
+        {
+            const size_t count = held + (missed - held) / 2;
+            steps.push_back(measure(renderer, count, config, config.measure, rng));
+            if (steps.back().sustained)
+            {
+                held = count;
+            }
+            else
+            {
+                missed = count;
+            }
+        }
+
+        // measure the result once more over a longer window for the per-phase report
+        const Step result = measure(renderer, held, config, config.measure * 2, rng);
+        renderer->setFrameTimingCapture(false);
+
+        spdlog::info("[Stress] renderer {} sustains {} objects at {:.0f} fps (p{:.0f} {:.2f} ms of {:.2f} ms)",
+                     renderer->getIndex(), held, config.fps, config.percentile * 100, result.frame_ms_percentile, 1000.0 / config.fps);
+
+        auto report = cJSON_CreateObject();
+        cJSON_AddStringToObject(report, "mode", renderer->isHeadless() ? "headless" : "window");
+        cJSON_AddNumberToObject(report, "fps", config.fps);
+        cJSON_AddNumberToObject(report, "budget_ms", 1000.0 / config.fps);
+        cJSON_AddNumberToObject(report, "margin", config.margin);
+        cJSON_AddNumberToObject(report, "percentile", config.percentile);
+        cJSON_AddNumberToObject(report, "max_objects", held);
+        cJSON_AddNumberToObject(report, "workers", jobs::getWorkerCount()); // scaling runs differ only here
+        cJSON_AddBoolToObject(report, "hit_limit", missed == 0);
+
+        auto steps_json = cJSON_CreateArray();
+        for (auto &step : steps)
+        {
+            cJSON_AddItemToArray(steps_json, stepToJson(step));
+        }
+        cJSON_AddItemToObject(report, "steps", steps_json);
+        cJSON_AddItemToObject(report, "at_max", phasesToJson(result));
+
+        const bool ok = writeReport(config.report_path, report);
+        cJSON_Delete(report);
+
+        if (ok)
+        {
+            spdlog::info("[Stress] report written to {}", config.report_path);
+        }
+        return ok;
+    }
+}
@@ -0,0 +1,353 @@
+#include "Threads/Topology.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace threads
+{
+    const char *ROLE_NAMES[(size_t)Role::COUNT] = {"main", "render", "input", "worker", "log", "listener"};
+
+    struct RoleConfig
+    {
+        bool set_nice = false;
+        int nice = 0;
+
+        bool set_policy = false;
+        int policy = SCHED_OTHER;
+        int priority = 0;
+
+        std::vector<int> cpus;
+    };
+
+    struct ThreadInfo
+    {
+        std::string name;
+        Role role;
+        pthread_t handle;
+        clockid_t clock;
+        bool alive;
+        double cpu_s; // final CPU time once the thread is gone
+    };
+
+    RoleConfig m_roles[(size_t)Role::COUNT];
+    double m_report_interval_s = 0;
+
+    std::mutex l_threads;
+    std::vector<ThreadInfo> m_threads;
+
+    double clockSeconds(clockid_t clock)
+    {
+        timespec ts;
+        if (clock_gettime(clock, &ts) != 0)
+        {
+            return 0;
+        }
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+    }
+
+    // Samples the final CPU time when the registered thread exits
+    struct Registration
+    {
+        size_t index = SIZE_MAX;
+
+        ~Registration()
+        {
+            if (index == SIZE_MAX)
+            {
+                return;
+            }
+
+            const double cpu_s = clockSeconds(CLOCK_THREAD_CPUTIME_ID);
+
+            l_threads.lock();
+            m_threads[index].alive = false;
+            m_threads[index].cpu_s = cpu_s;
+            l_threads.unlock();
+        }
+    };
+
+    thread_local Registration t_registration;
+
+    bool parseCpus(const std::string &value, std::vector<int> &cpus)
+    {
+        std::stringstream list(value);
+        std::string item;
+        while (std::getline(list, item, ','))
+        {
+            int first = 0, last = 0;
+            const auto dash = item.find('-');
+            try
+            {
+                first = std::stoi(item.substr(0, dash));
+                last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            }
+            catch (const std::exception &)
+            {
+                return false;
+            }
+
+            if (first < 0 || last < first || last >= CPU_SETSIZE)
+            {
+                return false;
+            }
+            for (int cpu = first; cpu <= last; cpu++)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        return !cpus.empty();
+    }
+
+    bool parsePolicy(const std::string &value, int &policy)
+    {
+        if (value == "other")
+            policy = SCHED_OTHER;
+        else if (value == "fifo")
+            policy = SCHED_FIFO;
+        else if (value == "rr")
+            policy = SCHED_RR;
+#ifdef __linux__
+        else if (value == "batch")
+            policy = SCHED_BATCH;
+        else if (value == "idle")
+            policy = SCHED_IDLE;
+#endif
+        else
+            return false;
+        return true;
+    }
+
+    bool loadConfig(const std::string &path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            spdlog::error("[Threads] could not open config {}", path);
+            return false;
+        }
+
+        RoleConfig roles[(size_t)Role::COUNT];
+        double report_interval_s = 0;
+
+        std::string line;
+        size_t line_number = 0;
+        while (std::getline(file, line))
+        {
+            line_number++;
+            line = line.substr(0, line.find('#'));
+
+            std::istringstream tokens(line);
+            std::string section;
+            if (!(tokens >> section))
+            {
+                continue;
+            }
+
+            RoleConfig *role = nullptr;
+            for (size_t i = 0; i < (size_t)Role::COUNT; i++)
+            {
+                if (section == ROLE_NAMES[i])
+                {
+                    role = &roles[i];
+                }
+            }
+
+            if (role == nullptr && section != "report")
+            {
+                spdlog::error("[Threads] {}:{} unknown role '{}'", path, line_number, section);
+                return false;
+            }
+
+            std::string token;
+            while (tokens >> token)
+            {
+                const auto eq = token.find('=');
+                const std::string key = token.substr(0, eq);
+                const std::string value = eq == std::string::npos ? "" : token.substr(eq + 1);
+
+                bool ok = true;
+                try
+                {
+                    if (value.empty())
+                    {
+                        ok = false;
+                    }
+                    else if (role == nullptr && key == "interval")
+                    {
+                        report_interval_s = std::stod(value);
+                    }
+                    else if (role != nullptr && key == "nice")
+                    {
+                        role->set_nice = true;
+                        role->nice = std::stoi(value);
+                        ok = role->nice >= -20 && role->nice <= 19;
+                    }
+                    else if (role != nullptr && key == "policy")
+                    {
+                        role->set_policy = true;
+                        ok = parsePolicy(value, role->policy);
+                    }
+                    else if (role != nullptr && key == "priority")
+                    {
+                        role->priority = std::stoi(value);
+                    }
+                    else if (role != nullptr && key == "cpus")
+                    {
+                        ok = parseCpus(value, role->cpus);
+                    }
+                    else
+                    {
+                        ok = false;
+                    }
+                }
+                catch (const std::exception &)
+                {
+                    ok = false;
+                }
+
+                if (!ok)
+                {
+                    spdlog::error("[Threads] {}:{} invalid setting '{}' for {}", path, line_number, token, section);
+                    return false;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < (size_t)Role::COUNT; i++)
+        {
+            m_roles[i] = roles[i];
+        }
+        m_report_interval_s = report_interval_s;
+
+        spdlog::info("[Threads] loaded topology from {}", path);
+        return true;
+    }
+
+    void applyRole(const RoleConfig &config, const std::string &name)
+    {
+#ifdef __linux__
+        if (config.set_nice)
+        {
+            // per thread on linux, nice applies to the calling task id
+            if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), config.nice) != 0)
+            {
+                spdlog::warn("[Threads] {}: could not set nice {}: {}", name, config.nice, strerror(errno));
+            }
+        }
+
+        if (!config.cpus.empty())
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : config.cpus)
+            {
+                CPU_SET(cpu, &set);
+            }
+
+            const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            if (err != 0)
+            {
+                spdlog::warn("[Threads] {}: could not set affinity: {}", name, strerror(err));
+            }
+        }
+#else
+        if (config.set_nice || !config.cpus.empty())
+        {
+            spdlog::warn("[Threads] {}: nice and cpus are only supported on linux", name);
+        }
+#endif
+
+        if (config.set_policy)
+        {
+            sched_param param = {};
+            param.sched_priority = (config.policy == SCHED_FIFO || config.policy == SCHED_RR) ? config.priority : 0;
+
+            const int err = pthread_setschedparam(pthread_self(), config.policy, &param);
+            if (err != 0)
+            {
+                spdlog::warn("[Threads] {}: could not set scheduling policy: {}", name, strerror(err));
+            }
+        }
+    }
+
+    void registerCurrent(Role role, const std::string &name)
+    {
+        const std::string short_name = name.substr(0, 15);
+
+#ifdef __linux__
+        pthread_setname_np(pthread_self(), short_name.c_str());
+#endif
+
+        applyRole(m_roles[(size_t)role], short_name);
+
+        ThreadInfo info = {short_name, role, pthread_self(), CLOCK_THREAD_CPUTIME_ID, true, 0};
+        pthread_getcpuclockid(info.handle, &info.clock);
+
+        l_threads.lock();
+        if (t_registration.index == SIZE_MAX)
+        {
+            t_registration.index = m_threads.size();
+            m_threads.push_back(info);
+        }
+        else
+        {
+            m_threads[t_registration.index] = info;
+        }
+        l_threads.unlock();
+    }
+
+    void logReport()
+    {
+        double registered_s = 0;
+
+        l_threads.lock();
+        spdlog::info("[Threads] {:<15} {:<8} {:>10}", "thread", "role", "cpu s");
+        for (auto &info : m_threads)
+        {
+            const double cpu_s = info.alive ? clockSeconds(info.clock) : info.cpu_s;
+            registered_s += cpu_s;
+            spdlog::info("[Threads] {:<15} {:<8} {:>10.3f}{}", info.name, ROLE_NAMES[(size_t)info.role], cpu_s, info.alive ? "" : " (exited)");
+        }
+        l_threads.unlock();
+
+        const double process_s = clockSeconds(CLOCK_PROCESS_CPUTIME_ID);
+        spdlog::info("[Threads] {:<15} {:<8} {:>10.3f}", "other (CEF)", "-", std::max(0.0, process_s - registered_s));
+    }
+
+    void startReporter()
+    {
+        if (m_report_interval_s <= 0)
+        {
+            return;
+        }
+
+        const double interval_s = m_report_interval_s;
+        std::thread([interval_s]() -> void
+                    {
+                        registerCurrent(Role::LISTENER, "thread-report");
+                        while (true)
+                        {
+                            std::this_thread::sleep_for(std::chrono::duration<double>(interval_s));
+                            logReport();
+                        } })
+            .detach();
+    }
+}
@@ -14,29 +14,294 @@
 #include "Objects/Ball.hpp"
 #include "Input/Input.hpp"
 #include "Renderer/Renderer.hpp"
+#include "Jobs/JobSystem.hpp"
+#include "Logging/Logging.hpp"
+#include "Threads/Topology.hpp"
+#include "Profiling/AllocTracker.hpp"
+#include "Profiling/Metrics.hpp"
+#include "Startup/Startup.hpp"
+#include "Stress/Stress.hpp"
 
 #include "webUi.hpp"
 #include "webUiBinding.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+
+// Stop every subsystem and exit, from any thread but the main one (it runs the WUI loop)
+static void shutdownAndExit(int code, bool input_running)
+{
+	spdlog::info("[Main] Shutting down");
+	wui::shutdown();
+	for (auto renderer : render::getRenderers())
+	{
+		renderer->shutdown();
+	}
+	if (input_running)
+	{
+		input::shutdown();
+	}
+
+	for (auto renderer : render::getRenderers())
+	{
+		renderer->waitUntilEnd();
+	}
+	jobs::shutdown();
+	metrics::stopServer();
+	threads::logReport();
+	alloc::logReport();
+	exit(code);
+}
+
 int main(int argc, char *argv[])
 {
 	// first thing to call in your program (Internal Fork)
-	WUI_ERROR_CHECK(wui::WuiInit());
+	{
+		startup::Phase phase("wui init");
+		WUI_ERROR_CHECK(wui::WuiInit());
+	}
+
+	// --windows N: number of independent renderers (windows) to open
+	// --workers N: job system worker threads, 0 = one less than the hardware threads
+	// --deterministic: reproducible parallel reductions
+	// --async-log: format and write log messages on a backend thread
+	// --verbose: show debug messages (if the build kept them, see WUI_LOG_LEVEL_FLOOR)
+	// --reserve-objects N: preallocate object storage per window
+	// --thread-config FILE: thread names, priorities and affinity per role (see Threads/Topology.hpp)
+	// --snapshot FILE: file for the save / load hotkeys (ctrl + s / ctrl + l)
+	// --load-snapshot FILE: start every window with the scene from FILE
+	// --alloc-strict: abort when an allocation-free region allocates (WUI_ALLOC_TRACKING builds)
+	// --ui-scale F: render the UI tab at F times the window resolution (0.25 - 1), ctrl + u cycles it at runtime
+	// --ui-viewport X,Y,W,H: window area covered by the UI tab, W / H <= 0 extend to the window edge
+	// --ui-layer NAME,Z,X,Y,W,H[,FPS]: one more UI tab composited over the main one (z 0), capped at FPS frames per second
+	// --ui-prewarm: keep a spare tab per UI layer loaded in the background, ctrl + c / ctrl + r restarts take it over
+	// --hud: start with the performance HUD shown (F3 toggles it)
+	// --ui-max-in-flight N: unacknowledged BallInfo messages before frames stop sending, 0 = unlimited
+	// --metrics ADDRESS: serve metrics in Prometheus text format on a loopback port ("9464") or "unix:/path"
+	// --headless: render into memory instead of windows, no input (the UI tabs still run)
+	// --no-soft-raster: headless renderers draw with Allegro's software primitives instead of the tiled rasterizer
+	// --stress FILE: find the highest ball count the first renderer sustains at 60 fps, write the report to FILE and exit
+	// --stress-margin F: frame budget headroom a stress step has to keep (default 0.1 = 10%)
+	size_t window_count = 1;
+	size_t worker_count = 0;
+	bool async_log = false;
+	size_t reserve_objects = 0;
+	const char *thread_config = nullptr;
+	std::string snapshot_path = "scene.wuisnap";
+	std::string load_snapshot;
+	std::string metrics_address;
+	bool headless = false;
+	bool stress_run = false;
+	stress::Config stress_config;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc)
+		{
+			window_count = std::max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+		{
+			worker_count = std::max(0, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--deterministic") == 0)
+		{
+			jobs::setDeterministic(true);
+		}
+		else if (strcmp(argv[i], "--async-log") == 0)
+		{
+			async_log = true;
+		}
+		else if (strcmp(argv[i], "--reserve-objects") == 0 && i + 1 < argc)
+		{
+			reserve_objects = std::max(0, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--thread-config") == 0 && i + 1 < argc)
+		{
+			thread_config = argv[++i];
+		}
+		else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc)
+		{
+			snapshot_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--load-snapshot") == 0 && i + 1 < argc)
+		{
+			load_snapshot = argv[++i];
+		}
+		else if (strcmp(argv[i], "--alloc-strict") == 0)
+		{
+			if (!alloc::isEnabled())
+			{
+				spdlog::warn("--alloc-strict needs a build with -DWUI_ALLOC_TRACKING=ON, ignored");
+			}
+			alloc::setStrict(true);
+		}
+		else if (strcmp(argv[i], "--ui-scale") == 0 && i + 1 < argc)
+		{
+			render::setDefaultUiScale(atof(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--ui-viewport") == 0 && i + 1 < argc)
+		{
+			int x, y, w, h;
+			if (sscanf(argv[++i], "%d,%d,%d,%d", &x, &y, &w, &h) != 4)
+			{
+				spdlog::error("--ui-viewport expects X,Y,W,H");
+				return 1;
+			}
+			render::setDefaultUiViewport(recti(x, y, w, h));
+		}
+		else if (strcmp(argv[i], "--ui-layer") == 0 && i + 1 < argc)
+		{
+			char name[32];
+			int z, x, y, w, h;
+			unsigned int fps = 0;
+			if (sscanf(argv[++i], "%31[^,],%d,%d,%d,%d,%d,%u", name, &z, &x, &y, &w, &h, &fps) < 6 || strcmp(name, render::MAIN_UI_LAYER) == 0)
+			{
+				spdlog::error("--ui-layer expects NAME,Z,X,Y,W,H[,FPS] with a name other than \"{}\"", render::MAIN_UI_LAYER);
+				return 1;
+			}
+
+			render::UiLayerConfig layer;
+			layer.name = name;
+			layer.z = z;
+			layer.viewport = recti(x, y, w, h);
+			layer.max_fps = fps;
+			render::addDefaultUiLayer(layer);
+		}
+		else if (strcmp(argv[i], "--ui-prewarm") == 0)
+		{
+			render::setDefaultUiPrewarm(true);
+		}
+		else if (strcmp(argv[i], "--hud") == 0)
+		{
+			render::setDefaultPerfHudVisible(true);
+		}
+		else if (strcmp(argv[i], "--ui-max-in-flight") == 0 && i + 1 < argc)
+		{
+			render::setMaxUiEventsInFlight(std::max(0, atoi(argv[++i])));
+		}
+		else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+		{
+			metrics_address = argv[++i];
+		}
+		else if (strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (strcmp(argv[i], "--no-soft-raster") == 0)
+		{
+			render::setDefaultSoftRaster(false);
+		}
+		else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc)
+		{
+			stress_run = true;
+			stress_config.report_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--stress-margin") == 0 && i + 1 < argc)
+		{
+			stress_config.margin = std::clamp(atof(argv[++i]), 0.0, 0.9);
+		}
+		else if (strcmp(argv[i], "--verbose") == 0)
+		{
+			spdlog::set_level(spdlog::level::debug);
+		}
+	}
 
-	// init renderer and display
+	if (thread_config != nullptr && !threads::loadConfig(thread_config))
+	{
+		return 1;
+	}
+	threads::registerCurrent(threads::Role::MAIN, "main");
 
-	if (!al_init())
+	if (!metrics_address.empty() && !metrics::startServer(metrics_address))
 	{
-		spdlog::error("Failed to initialize allegro");
 		return 1;
 	}
 
-	input::start();
-	render::renderer.start();
+	if (async_log)
+	{
+		logging::startAsync();
+	}
+
+	render::setDefaultHeadless(headless);
+	if (stress_run)
+	{
+		// waiting for the flip would fill every frame up to the budget
+		render::setDefaultVsync(false);
+	}
+
+	// Independent init steps run concurrently:
+	// allegro -> input drivers, allegro + jobs -> displays, and the offscreen tabs (CEF) right away
+	std::vector<render::Renderer *> renderers;
+	for (size_t i = 0; i < window_count; i++)
+	{
+		renderers.push_back(render::createRenderer());
+	}
+	startup::expectFirstFrames(window_count);
+
+	startup::TaskGraph init;
+	auto allegro = init.add("allegro", {}, []()
+							{
+		if (!al_init())
+		{
+			spdlog::error("Failed to initialize allegro");
+			exit(1);
+		} });
+	auto workers = init.add("jobs", {}, [=]()
+							{ jobs::start(worker_count); });
+	startup::TaskGraph::task_t input_task = 0;
+	if (!headless)
+	{
+		input_task = init.add("input", {allegro}, []()
+							  { input::start(); });
+	}
+
+	for (auto renderer : renderers)
+	{
+		// the tab only needs its size, the display is created by the render thread itself
+		init.add(fmt::format("ui tab {}", renderer->getIndex()), {}, [=]()
+				 { renderer->restartWui(); });
+		init.add(fmt::format("renderer {}", renderer->getIndex()), {allegro, workers}, [=]()
+				 {
+			renderer->reserveObjects(reserve_objects);
+			if (!load_snapshot.empty())
+			{
+				renderer->loadSnapshot(load_snapshot);
+			}
+			renderer->start(false); });
+	}
+
+	init.start();
+
+	if (!headless)
+	{
+		// every listener below waits on input
+		init.wait(input_task);
+	}
+	threads::startReporter();
+
+	if (stress_run)
+	{
+		std::thread([=]() -> void
+					{
+			threads::registerCurrent(threads::Role::LISTENER, "stress");
+			const bool ok = stress::run(renderers.front(), stress_config);
+			shutdownAndExit(ok ? 0 : 1, !headless); })
+			.detach();
+	}
+
+	if (headless)
+	{
+		// no input to listen to, the tabs still need the WUI loop
+		wui::runTimeLoop();
+		pthread_exit(NULL);
+	}
 
 	// esc shutdown
 	std::thread([=]() -> void
 				{
+					threads::registerCurrent(threads::Role::LISTENER, "esc");
 					auto ok = input::wait_for_keys({ALLEGRO_KEY_ESCAPE,ALLEGRO_KEY_LCTRL});
 
 					if (!ok)
@@ -45,38 +310,104 @@ int main(int argc, char *argv[])
 						return;
 					}
 
-					spdlog::info("[Main] Shutting down");
-					wui::shutdown();
-					render::renderer.shutdown();
-					input::shutdown();
-					
-					render::renderer.waitUntilEnd();
-					exit(0); // clean exit
+					shutdownAndExit(0, true); // clean exit
 					return; })
 		.detach();
 
 	// click listener
 	std::thread([=]() -> void
 				{
+                	threads::registerCurrent(threads::Role::LISTENER, "click");
                 	while (true)
                 	{
 						vec2i pos;
-                    	auto ok = input::wait_for_mouse_button(2, pos);
+						ALLEGRO_DISPLAY *display = nullptr;
+                    	auto ok = input::wait_for_mouse_button(2, pos, &display);
 						if (!ok)
 						{
 							spdlog::info("Stop click listener");
 							return;
 						}
 
-						spdlog::info("Adding ball at {} {}", pos.x, pos.y);
-						render::renderer.addObject(std::make_shared<objects::Ball>(pos.x, pos.y));
+						auto renderer = render::getRenderer(display);
+						if (renderer == nullptr)
+						{
+							continue;
+						}
+
+						// right click on a ball removes it, anywhere else spawns one
+						auto hit = renderer->pickObject(pos);
+						if (hit.valid())
+						{
+							SPDLOG_DEBUG("Removing ball at {} {} from renderer {}", pos.x, pos.y, renderer->getIndex());
+							renderer->destroyObject(hit);
+							continue;
+						}
+
+						SPDLOG_DEBUG("Adding ball at {} {} to renderer {}", pos.x, pos.y, renderer->getIndex());
+						renderer->spawnBall(pos.x, pos.y);
 				  	}
 				return; })
 		.detach();
 
+	// left drag outside the UI: rubber band selection
+	std::thread([=]() -> void
+				{
+		threads::registerCurrent(threads::Role::LISTENER, "select");
+		while (true)
+		{
+			recti area;
+			ALLEGRO_DISPLAY *display = nullptr;
+			auto ok = input::wait_for_mouse_drag(1, area, &display);
+			if (!ok)
+			{
+				spdlog::info("Stop selection listener");
+				return;
+			}
+
+			auto renderer = render::getRenderer(display);
+			if (renderer != nullptr)
+			{
+				// a plain click selects whatever is under it
+				renderer->selectObjects(area);
+			}
+		}
+				return; })
+		.detach();
+
+	// delete removes the selected objects of the focused window
+	std::thread([=]() -> void
+				{
+		threads::registerCurrent(threads::Role::LISTENER, "select-delete");
+		while (true)
+		{
+			auto ok = input::wait_for_key(ALLEGRO_KEY_DELETE);
+
+			if (!ok)
+			{
+				spdlog::info("Stop selection delete listener");
+				return;
+			}
+
+			// ctrl + delete belongs to the clear listener
+			if (input::is_key_down(ALLEGRO_KEY_LCTRL))
+			{
+				continue;
+			}
+
+			auto renderer = render::getFocusedRenderer();
+			if (renderer != nullptr)
+			{
+				renderer->deleteSelected();
+			}
+		}
+				return; })
+		.detach();
+
 	// debug 'o' key
 	std::thread([=]() -> void
 				{
+		threads::registerCurrent(threads::Role::LISTENER, "close-ui");
 		while (true)
 		{
 			auto ok = input::wait_for_keys({ALLEGRO_KEY_C,ALLEGRO_KEY_LCTRL});
@@ -87,24 +418,144 @@ int main(int argc, char *argv[])
 				return;
 			}
 
-			if (render::renderer.wui_tab_id>0){
-				auto tmp = render::renderer.wui_tab_id;
-			render::renderer.wui_tab_id = 0;
+			auto renderer = render::getFocusedRenderer();
+			if (renderer != nullptr)
+			{
+				renderer->closeWui();
+			}
+					}
+				return; })
+		.detach();
+
+	// ctrl + delete clears all objects of the focused window
+	std::thread([=]() -> void
+				{
+		threads::registerCurrent(threads::Role::LISTENER, "clear");
+		while (true)
+		{
+			auto ok = input::wait_for_keys({ALLEGRO_KEY_DELETE, ALLEGRO_KEY_LCTRL});
+
+			if (!ok)
+			{
+				spdlog::info("Stop Delete listener");
+				return;
+			}
+
+			auto renderer = render::getFocusedRenderer();
+			if (renderer != nullptr)
+			{
+				renderer->clearObjects();
+			}
+		}
+				return; })
+		.detach();
 
-			WUI_ERROR_CHECK(wui::unregisterEventListener(tmp, "DeleteBall")); // not strictly necessary, deleting the tab deletes the router that holds this callback
+	// F3 toggles the focused window's performance HUD
+	std::thread([=]() -> void
+				{
+		threads::registerCurrent(threads::Role::LISTENER, "hud");
+		while (true)
+		{
+			auto ok = input::wait_for_key(ALLEGRO_KEY_F3);
 
-			WUI_ERROR_CHECK(wui::closeOffscreenTab(tmp));
-			spdlog::info("Destroyed tab {}", tmp);
+			if (!ok)
+			{
+				spdlog::info("Stop HUD listener");
+				return;
 			}
 
-		
+			auto renderer = render::getFocusedRenderer();
+			if (renderer != nullptr)
+			{
+				renderer->togglePerfHud();
+			}
+		}
+				return; })
+		.detach();
+
+	// ctrl + u cycles the focused window's UI render scale
+	std::thread([=]() -> void
+				{
+		threads::registerCurrent(threads::Role::LISTENER, "ui-scale");
+		const float scales[] = {1.0f, 0.75f, 0.5f};
+		while (true)
+		{
+			auto ok = input::wait_for_keys({ALLEGRO_KEY_U, ALLEGRO_KEY_LCTRL});
+
+			if (!ok)
+			{
+				spdlog::info("Stop UI scale listener");
+				return;
+			}
+
+			auto renderer = render::getFocusedRenderer();
+			if (renderer != nullptr)
+			{
+				// next smaller step, wrapping around to full resolution
+				float next = scales[0];
+				for (float scale : scales)
+				{
+					if (scale < renderer->getUiScale() - 0.01f)
+					{
+						next = scale;
+						break;
 					}
+				}
+				renderer->setUiScale(next);
+			}
+		}
+				return; })
+		.detach();
+
+	// ctrl + s / ctrl + l save / load the focused window's scene
+	std::thread([=]() -> void
+				{
+		threads::registerCurrent(threads::Role::LISTENER, "snapshot-save");
+		while (true)
+		{
+			auto ok = input::wait_for_keys({ALLEGRO_KEY_S, ALLEGRO_KEY_LCTRL});
+
+			if (!ok)
+			{
+				spdlog::info("Stop snapshot save listener");
+				return;
+			}
+
+			auto renderer = render::getFocusedRenderer();
+			if (renderer != nullptr)
+			{
+				renderer->saveSnapshot(snapshot_path);
+			}
+		}
+				return; })
+		.detach();
+
+	std::thread([=]() -> void
+				{
+		threads::registerCurrent(threads::Role::LISTENER, "snapshot-load");
+		while (true)
+		{
+			auto ok = input::wait_for_keys({ALLEGRO_KEY_L, ALLEGRO_KEY_LCTRL});
+
+			if (!ok)
+			{
+				spdlog::info("Stop snapshot load listener");
+				return;
+			}
+
+			auto renderer = render::getFocusedRenderer();
+			if (renderer != nullptr)
+			{
+				renderer->loadSnapshot(snapshot_path);
+			}
+		}
 				return; })
 		.detach();
 
 	// r key restart UI
 	std::thread([=]() -> void
 				{
+		threads::registerCurrent(threads::Role::LISTENER, "restart-ui");
 		while (true)
 		{
 			auto ok = input::wait_for_keys({ALLEGRO_KEY_R, ALLEGRO_KEY_LCTRL});
@@ -115,7 +566,11 @@ int main(int argc, char *argv[])
 				return;
 			}
 
-					render::renderer.restartWui();
+					auto renderer = render::getFocusedRenderer();
+					if (renderer != nullptr)
+					{
+						renderer->restartWui();
+					}
 		
 					}
 				return; })